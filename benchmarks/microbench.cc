@@ -0,0 +1,215 @@
+//
+// Created by Hugo Bogaart on 18/10/2026.
+//
+
+// microbenchmarks of the kernels of the engine, each on its own
+// every kernel runs over a corpus of positions, and reports ns and cycles per call
+// the cycles are timestamp counter ticks, so they are only comparable on the same machine
+
+#include "../src/Engine/movegen.h"
+#include "../src/Engine/position.h"
+#include "../src/Engine/eval.h"
+#include "../src/Engine/nnue.h"
+#include "../src/Engine/transtable.h"
+#include "../src/Engine/zobrist-hash.h"
+#include "../src/cli/cli-utils.h"
+#include "../unit-tests/test-positions.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+inline auto cycle_count () -> uint64_t {return __rdtsc();}
+#else
+inline auto cycle_count () -> uint64_t {return 0;}
+#endif
+
+// keeps the compiler from optimizing away a result
+template <typename T>
+inline auto do_not_optimize (const T &value) -> void
+{
+        asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// a position together with one of its legal moves
+struct PositionMove {
+        PositionHashPair pos_hash;
+        Move move;
+};
+
+// every position up to some ply from the perft positions, each with one of its moves
+auto make_corpus (int ply) -> std::vector<PositionMove>
+{
+        std::vector<PositionMove> corpus;
+        for (const Position &pos : collect_perft_positions(ply)) {
+                MoveList mlist;
+                if (pos.meta.active == Color::white)
+                        generate_moves<Color::white>(pos, mlist);
+                else
+                        generate_moves<Color::black>(pos, mlist);
+                if (mlist.empty())
+                        continue;
+
+                // spread the moves, instead of always the first one
+                corpus.emplace_back(PositionHashPair{pos, zobrist_hash(pos)}, mlist[corpus.size() % mlist.size()]);
+        }
+        return corpus;
+}
+
+// runs the kernel over the whole corpus until enough time has passed
+// and prints the time and cycles of a single call
+template <typename Kernel>
+auto run_benchmark (const std::string &name, const std::vector<PositionMove> &corpus, Kernel &&kernel) -> void
+{
+        constexpr auto min_time = std::chrono::milliseconds(300);
+
+        // warm up the caches and the branch predictors
+        for (const PositionMove &pm : corpus)
+                kernel(pm);
+
+        size_t calls = 0;
+        const uint64_t start_cycles = cycle_count();
+        const auto start = std::chrono::steady_clock::now();
+        auto now = start;
+        while (now - start < min_time) {
+                for (const PositionMove &pm : corpus)
+                        kernel(pm);
+                calls += corpus.size();
+                now = std::chrono::steady_clock::now();
+        }
+        const uint64_t cycles = cycle_count() - start_cycles;
+        const double ns = std::chrono::duration<double, std::nano>(now - start).count();
+
+        std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << ns / static_cast<double>(calls) << " ns/op"
+                  << std::setw(10) << static_cast<double>(cycles) / static_cast<double>(calls) << " cycles/op"
+                  << std::setw(14) << calls << " calls\n";
+}
+
+int main ()
+{
+        const std::vector<PositionMove> corpus = make_corpus(2);
+        std::cout << "corpus of " << corpus.size() << " positions\n\n";
+
+        run_benchmark("generate_moves", corpus, [](const PositionMove &pm) {
+                MoveList mlist;
+                if (pm.pos_hash.pos.meta.active == Color::white)
+                        generate_moves<Color::white>(pm.pos_hash.pos, mlist);
+                else
+                        generate_moves<Color::black>(pm.pos_hash.pos, mlist);
+                do_not_optimize(mlist);
+        });
+
+        run_benchmark("static_eval", corpus, [](const PositionMove &pm) {
+                do_not_optimize(static_eval(pm.pos_hash.pos));
+        });
+
+        // both attack maps, the way static_eval uses them
+        run_benchmark("attack_map lookup", corpus, [](const PositionMove &pm) {
+                const Position &pos = pm.pos_hash.pos;
+                do_not_optimize(pos.attack_map<Color::white, SliderAttacks::lookup_table>()
+                        ^ pos.attack_map<Color::black, SliderAttacks::lookup_table>());
+        });
+
+        run_benchmark("attack_map kogge-stone", corpus, [](const PositionMove &pm) {
+                const Position &pos = pm.pos_hash.pos;
+                do_not_optimize(pos.attack_map<Color::white, SliderAttacks::kogge_stone>()
+                        ^ pos.attack_map<Color::black, SliderAttacks::kogge_stone>());
+        });
+
+        run_benchmark("attack_map ks avx2", corpus, [](const PositionMove &pm) {
+                const Position &pos = pm.pos_hash.pos;
+                do_not_optimize(pos.attack_map<Color::white, SliderAttacks::kogge_stone_avx2>()
+                        ^ pos.attack_map<Color::black, SliderAttacks::kogge_stone_avx2>());
+        });
+
+        // the same positions evaluated in blocks, one by one and as a batch
+        // a call is counted per position, so the times compare directly with static_eval
+        constexpr size_t block_size = 64;
+        std::vector<Position> positions;
+        for (const PositionMove &pm : corpus)
+                positions.push_back(pm.pos_hash.pos);
+        std::vector<Eval> evals(positions.size());
+        auto block_of = [&](const PositionMove &pm) -> std::optional<size_t> {
+                const size_t i = &pm - corpus.data();
+                if (i % block_size)
+                        return std::nullopt;
+                return std::min(block_size, positions.size() - i);
+        };
+
+        run_benchmark("static_eval loop", corpus, [&](const PositionMove &pm) {
+                const size_t i = &pm - corpus.data();
+                if (const auto size = block_of(pm)) {
+                        for (size_t j = i; j < i + *size; j++)
+                                evals[j] = static_eval(positions[j]);
+                        do_not_optimize(evals[i]);
+                }
+        });
+
+        run_benchmark("static_eval_batch", corpus, [&](const PositionMove &pm) {
+                const size_t i = &pm - corpus.data();
+                if (const auto size = block_of(pm)) {
+                        static_eval_batch(std::span(positions).subspan(i, *size), std::span(evals).subspan(i, *size));
+                        do_not_optimize(evals[i]);
+                }
+        });
+
+        // the speed does not depend on the weights, so random ones will do
+        const std::unique_ptr<Nnue::Network> net = random_network();
+
+        // the accumulator of the position itself, like in the search
+        std::vector<Nnue::Accumulator> accumulators(corpus.size());
+        for (size_t i = 0; i < corpus.size(); i++)
+                Nnue::refresh(*net, corpus[i].pos_hash.pos, accumulators[i]);
+
+        run_benchmark("Nnue::evaluate", corpus, [&](const PositionMove &pm) {
+                const size_t i = &pm - corpus.data();
+                do_not_optimize(Nnue::evaluate(*net, accumulators[i], pm.pos_hash.pos.meta.active));
+        });
+
+        run_benchmark("Nnue::update", corpus, [&](const PositionMove &pm) {
+                const size_t i = &pm - corpus.data();
+                PositionHashPair next = pm.pos_hash;
+                if (next.pos.meta.active == Color::white)
+                        make_move_unsafe<Color::white>(pm.move, next);
+                else
+                        make_move_unsafe<Color::black>(pm.move, next);
+                Nnue::Accumulator child;
+                Nnue::update(*net, pm.pos_hash.pos, next.pos, accumulators[i], child);
+                do_not_optimize(child);
+        });
+
+        run_benchmark("zobrist_hash", corpus, [](const PositionMove &pm) {
+                do_not_optimize(zobrist_hash(pm.pos_hash.pos));
+        });
+
+        run_benchmark("make_move_unsafe", corpus, [](const PositionMove &pm) {
+                PositionHashPair next = pm.pos_hash;
+                if (next.pos.meta.active == Color::white)
+                        make_move_unsafe<Color::white>(pm.move, next);
+                else
+                        make_move_unsafe<Color::black>(pm.move, next);
+                do_not_optimize(next);
+        });
+
+        // half of the corpus is in the table, so it measures both hits and misses
+        // the table is much bigger than the caches, like in a real search
+        TransTable tt(TransTable::MegaByte(256));
+        for (size_t i = 0; i < corpus.size(); i += 2) {
+                const uint64_t hash = corpus[i].pos_hash.hash;
+                if (TransTable::Node *node = tt.find_bucket(hash).find_empty())
+                        node->hash = hash;
+        }
+        run_benchmark("TransTable::find", corpus, [&](const PositionMove &pm) {
+                do_not_optimize(tt.find(pm.pos_hash.hash));
+        });
+
+        return 0;
+}
@@ -147,6 +147,12 @@ auto square_to_shift (OneSquare sq) -> int;
 constexpr
 auto OneSquare_unsafe (Field f) -> OneSquare;
 
+// returns the square of the least significant bit of a field that is not 0
+// to loop over all squares in a field:
+// for (Field f = field; f; f &= f - 1) { const OneSquare sq = lowest_square(f); ... }
+constexpr
+auto lowest_square (Field not_zero) -> OneSquare;
+
 // the king/single-tile moves
 // used for shifts
 enum Direction : uint8_t {
@@ -264,6 +270,23 @@ auto get_free_straights(const OneSquare &point) -> Field;
 inline
 auto get_weakly_blocked_straights (const OneSquare &point, const Field &weak) -> Field;
 
+// like the weakly blocked functions, but for all sliders in the field at once
+// these use a kogge-stone occluded fill, so no lookup tables and no loop over the sliders
+template <Direction dir>
+constexpr
+auto get_all_weakly_blocked_rays (Field sliders, Field weak) -> Field;
+
+constexpr
+auto get_all_weakly_blocked_straights (Field sliders, Field weak) -> Field;
+
+constexpr
+auto get_all_weakly_blocked_diagonals (Field sliders, Field weak) -> Field;
+
+// the union of get_all_weakly_blocked_straights and get_all_weakly_blocked_diagonals
+// with avx2, the four directions going up and the four going down are each filled in one register
+inline
+auto get_all_weakly_blocked_sliders_avx2 (Field straight_sliders, Field diagonal_sliders, Field weak) -> Field;
+
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -333,6 +356,12 @@ auto OneSquare_unsafe (Field f) -> OneSquare
         return sq;
 }
 
+constexpr
+auto lowest_square (Field not_zero) -> OneSquare
+{
+        return square_from_shift(trailing_0_count(not_zero));
+}
+
 template <>
 constexpr
 void shift<north>(Field &fd)
@@ -731,6 +760,129 @@ auto get_weakly_blocked_straights (const OneSquare &point, const Field &weak) ->
         }
 }
 
+// the shift of one step in some direction, to the left if positive
+consteval
+auto direction_shift (Direction dir) -> int
+{
+        switch (dir) {
+        case north:     return 8;
+        case northEast: return 9;
+        case east:      return 1;
+        case southEast: return -7;
+        case south:     return -8;
+        case southWest: return -9;
+        case west:      return -1;
+        case northWest: return 7;
+        }
+        return 0;
+}
+
+// after a step in some direction, this masks off the squares that wrapped around the board
+consteval
+auto direction_wrap_mask (Direction dir) -> Field
+{
+        switch (dir) {
+        case northEast:
+        case east:
+        case southEast: return msk::LEFT;
+        case southWest:
+        case west:
+        case northWest: return msk::RIGHT;
+        default:        return ~0ull;
+        }
+}
+
+template <Direction dir>
+constexpr
+auto get_all_weakly_blocked_rays (const Field sliders, const Field weak) -> Field
+{
+        constexpr int sh = direction_shift(dir);
+        constexpr Field wrap = direction_wrap_mask(dir);
+
+        auto step = [](Field f, int n) -> Field {
+                if constexpr (sh > 0)
+                        return f << (sh * n);
+                else
+                        return f >> (-sh * n);
+        };
+
+        // the sliders spread out over the empty squares in 1, 2 and 4 steps
+        // the wrap mask keeps them from going around the board
+        Field empty = ~weak & wrap;
+        Field gen = sliders;
+        gen   |= empty & step(gen, 1);
+        empty &= step(empty, 1);
+        gen   |= empty & step(gen, 2);
+        empty &= step(empty, 2);
+        gen   |= empty & step(gen, 4);
+
+        // one more step selects the obstacles and leaves out the sliders
+        return step(gen, 1) & wrap;
+}
+
+constexpr
+auto get_all_weakly_blocked_straights (const Field sliders, const Field weak) -> Field
+{
+        return get_all_weakly_blocked_rays<north>(sliders, weak)
+             | get_all_weakly_blocked_rays<east>(sliders, weak)
+             | get_all_weakly_blocked_rays<south>(sliders, weak)
+             | get_all_weakly_blocked_rays<west>(sliders, weak);
+}
+
+constexpr
+auto get_all_weakly_blocked_diagonals (const Field sliders, const Field weak) -> Field
+{
+        return get_all_weakly_blocked_rays<northEast>(sliders, weak)
+             | get_all_weakly_blocked_rays<southEast>(sliders, weak)
+             | get_all_weakly_blocked_rays<southWest>(sliders, weak)
+             | get_all_weakly_blocked_rays<northWest>(sliders, weak);
+}
+
+inline
+auto get_all_weakly_blocked_sliders_avx2 (const Field straight_sliders, const Field diagonal_sliders, const Field weak) -> Field
+{
+#ifdef __AVX2__
+        // the lanes are north, east, northEast, northWest when going up
+        // and south, west, southWest, southEast when going down
+        // these have the same shifts, so going down is the same with right shifts
+        const __m256i shift1 = _mm256_setr_epi64x(8, 1, 9, 7);
+        const __m256i shift2 = _mm256_add_epi64(shift1, shift1);
+        const __m256i shift4 = _mm256_add_epi64(shift2, shift2);
+
+        const __m256i up_wrap   = _mm256_setr_epi64x(~0ll, msk::LEFT, msk::LEFT, msk::RIGHT);
+        const __m256i down_wrap = _mm256_setr_epi64x(~0ll, msk::RIGHT, msk::RIGHT, msk::LEFT);
+
+        const __m256i sliders  = _mm256_setr_epi64x(straight_sliders, straight_sliders, diagonal_sliders, diagonal_sliders);
+        const __m256i not_weak = _mm256_set1_epi64x(~weak);
+
+        // same as get_all_weakly_blocked_rays, four directions at a time
+        __m256i empty = _mm256_and_si256(not_weak, up_wrap);
+        __m256i gen   = sliders;
+        gen   = _mm256_or_si256(gen, _mm256_and_si256(empty, _mm256_sllv_epi64(gen, shift1)));
+        empty = _mm256_and_si256(empty, _mm256_sllv_epi64(empty, shift1));
+        gen   = _mm256_or_si256(gen, _mm256_and_si256(empty, _mm256_sllv_epi64(gen, shift2)));
+        empty = _mm256_and_si256(empty, _mm256_sllv_epi64(empty, shift2));
+        gen   = _mm256_or_si256(gen, _mm256_and_si256(empty, _mm256_sllv_epi64(gen, shift4)));
+        const __m256i up = _mm256_and_si256(_mm256_sllv_epi64(gen, shift1), up_wrap);
+
+        empty = _mm256_and_si256(not_weak, down_wrap);
+        gen   = sliders;
+        gen   = _mm256_or_si256(gen, _mm256_and_si256(empty, _mm256_srlv_epi64(gen, shift1)));
+        empty = _mm256_and_si256(empty, _mm256_srlv_epi64(empty, shift1));
+        gen   = _mm256_or_si256(gen, _mm256_and_si256(empty, _mm256_srlv_epi64(gen, shift2)));
+        empty = _mm256_and_si256(empty, _mm256_srlv_epi64(empty, shift2));
+        gen   = _mm256_or_si256(gen, _mm256_and_si256(empty, _mm256_srlv_epi64(gen, shift4)));
+        const __m256i down = _mm256_and_si256(_mm256_srlv_epi64(gen, shift1), down_wrap);
+
+        // and all lanes together
+        const __m256i both = _mm256_or_si256(up, down);
+        const __m128i half = _mm_or_si128(_mm256_castsi256_si128(both), _mm256_extracti128_si256(both, 1));
+        return _mm_cvtsi128_si64(half) | _mm_extract_epi64(half, 1);
+#else
+        return get_all_weakly_blocked_straights(straight_sliders, weak) | get_all_weakly_blocked_diagonals(diagonal_sliders, weak);
+#endif
+}
+
 constexpr std::array<OneSquare, 64> all_squares = []() constexpr {
         OneSquare arr[64];
         for (int i = 0; i < 64; i++)
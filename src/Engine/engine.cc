@@ -5,7 +5,12 @@
 
 auto Engine::fill_alpha_beta (int depth) -> void
 {
-        bool run = true; // for the threads (we don't use that in this function)
+        std::atomic<bool> run = true; // for the threads (we don't use that in this function)
+
+        // the search still keeps its line and its caches in the arguments of the first worker
+        thread_pool.make_threads(1);
+        prepare_eval(thread_pool.worker_args[0]);
+
         if (root.pos.meta.active == Color::white) {
                 (void)alpha_beta_col<Color::white>(root, worst_white, worst_black, depth, run);
         } else {
@@ -13,6 +18,26 @@ auto Engine::fill_alpha_beta (int depth) -> void
         }
 }
 
+auto Engine::set_network (std::unique_ptr<Nnue::Network> net) -> void
+{
+        network = std::move(net);
+
+        // the cached evals may be of the old network
+        for (size_t i = 0; i < thread_pool.num_threads; i++)
+                thread_pool.worker_args[i].eval_cache.clear();
+}
+
+auto Engine::prepare_eval (ThreadArgs &targs) -> void
+{
+        const Nnue::Network *const net = active_network();
+        if (targs.cache_holds_network_evals != (net != nullptr)) {
+                targs.eval_cache.clear();
+                targs.cache_holds_network_evals = net != nullptr;
+        }
+        if (net)
+                targs.accumulators.reset(*net, root.pos);
+}
+
 auto Engine::demand_eval () const -> std::optional<Eval>
 {
         auto p = tt.find(root.hash);
@@ -119,25 +144,42 @@ auto Engine::stop () -> void
         // we only let one thread handle the threads at a time
         std::lock_guard _(thread_pool.mtx);
 
-        // because we already did that
-        this->workers_should_kill_themselves = false;
-
         // tell the threads to stop working
-        for (int i = 0; i < thread_pool.num_threads; i++) {
-                thread_pool.worker_args[i].run = false;
-        }
+        stop_workers();
 
         // and join them in
-        for (int i = 0; i < thread_pool.num_threads; i++) {
+        for (size_t i = 0; i < thread_pool.num_threads; i++) {
                 if (thread_pool.worker_threads[i].joinable()) {
                         thread_pool.worker_threads[i].join();
                 }
         }
 
-        if (this->send_bestmove != nullptr && this->should_send_best_move){
-                this->should_send_best_move = false;
+        // the worker has sent it already, unless the engine was not searching
+        send_best_move_once();
+}
+
+auto Engine::stop_workers () -> void
+{
+        for (size_t i = 0; i < thread_pool.num_threads; i++)
+                thread_pool.worker_args[i].run = false;
+}
+
+auto Engine::send_best_move_once () -> void
+{
+        if (this->send_bestmove != nullptr && this->should_send_best_move.exchange(false))
                 send_bestmove(request_best_move(), active_color());
+}
+
+auto Engine::forget_restricted_root () -> void
+{
+        if (!restricted_root_hash)
+                return;
+
+        if (TransTable::Node *to_root = tt.find(*restricted_root_hash)) {
+                to_root->hash = 0;
+                num_full_nodes--;
         }
+        restricted_root_hash.reset();
 }
 
 auto Engine::iterative_deepen(int start_ply, int max_ply) -> void
@@ -145,9 +187,166 @@ auto Engine::iterative_deepen(int start_ply, int max_ply) -> void
         while (start_ply <= max_ply) {
                 ++current_gen;
                 fill_alpha_beta(start_ply++);
+                ThreadArgs &targs = thread_pool.worker_args[0];
+                targs.pv.previous = root_line(targs);
+        }
+}
+
+auto Engine::root_score (Eval eval, TransTable::Node::NodeType ntype) const -> SendInfoArgs::Score
+{
+        const bool is_white = active_color() == Color::white;
+
+        SendInfoArgs::Score score;
+        score.engine_perspective = is_white ? eval : -eval;
+        score.lower_bound = ntype == TransTable::Node::lowerbound;
+        score.upper_bound = ntype == TransTable::Node::upperbound;
+        if (is_mate(eval)) {
+                int num_plies;
+                if (white_is_mated(eval))
+                        num_plies = eval - worst_white;
+                else
+                        num_plies = worst_black - eval;
+
+                bool opponent_is_mated = is_white == black_is_mated(eval);
+
+                // the amount of moves to the mate, not plies
+                // int num_moves = opponent_is_mated ? (1 + num_plies) / 2 : num_plies / 2;
+                int num_moves = (1 + num_plies) / 2;
+
+                score.mate = opponent_is_mated ? num_moves : -num_moves;
+        }
+        return score;
+}
+
+auto Engine::root_line (const ThreadArgs &targs) const -> std::vector<Move>
+{
+        std::vector<Move> line = targs.pv.line();
+        if (line.empty()) {
+                const TransTable::Node *to_root = tt.find(root.hash);
+                if (to_root != nullptr && to_root->depth_searched > 0)
+                        line.push_back(to_root->best_move);
+        }
+        return line;
+}
+
+auto Engine::iteration_ends_search (Move best_move, Eval eval) -> bool
+{
+        if (mate_limit) {
+                const std::optional<int> mate = root_score(eval, TransTable::Node::exact).mate;
+                if (mate && *mate > 0 && static_cast<size_t>(*mate) <= *mate_limit)
+                        return true;
+        }
+
+        if (!time_manager)
+                return false;
+
+        // worst_white has no negation
+        const Eval score = active_color() == Color::white ? eval : -std::max(eval, worst_white + 1);
+        const TimeManager::Millis elapsed = std::chrono::steady_clock::now() - search_start_timepoint;
+        return time_manager->should_stop(best_move, score, elapsed);
+}
+
+auto Engine::reset_node_count () -> void
+{
+        polled_nodes = 0;
+        for (size_t t = 0; t < thread_pool.num_threads; ++t) {
+                ThreadArgs &targs = thread_pool.worker_args[t];
+                targs.poll_batch = node_limit ? std::clamp<size_t>(*node_limit, 1, node_poll_interval) : node_poll_interval;
+                targs.nodes_to_poll = targs.poll_batch;
+        }
+}
+
+auto Engine::poll_limits (ThreadArgs &targs) -> void
+{
+        const size_t searched = polled_nodes.fetch_add(targs.poll_batch, std::memory_order_relaxed) + targs.poll_batch;
+        const bool past_deadline = deadline && std::chrono::steady_clock::now() >= *deadline;
+        if (past_deadline || (node_limit && searched >= *node_limit)) {
+                stop_workers();
+                // no more polls until the next search
+                targs.poll_batch = 0;
+                targs.nodes_to_poll = std::numeric_limits<size_t>::max();
+                return;
+        }
+
+        // the last batch ends right at the limit
+        targs.poll_batch = node_limit ? std::min(node_poll_interval, *node_limit - searched) : node_poll_interval;
+        targs.nodes_to_poll = targs.poll_batch;
+}
+
+auto Engine::searched_nodes () const -> size_t
+{
+        size_t nodes = polled_nodes.load(std::memory_order_relaxed);
+        for (size_t t = 0; t < thread_pool.num_threads; ++t) {
+                const ThreadArgs &targs = thread_pool.worker_args[t];
+                if (targs.nodes_to_poll <= targs.poll_batch)
+                        nodes += targs.poll_batch - targs.nodes_to_poll;
+        }
+        return nodes;
+}
+
+auto Engine::complete_line (std::vector<Move> &line, size_t length) const -> void
+{
+        // the positions along the line, to find the end and to stop at a repetition
+        PositionHashPair pos_hash = root;
+        std::vector<uint64_t> seen = {pos_hash.hash};
+        auto play = [&](Move mv) -> void {
+                if (pos_hash.pos.meta.active == Color::white)
+                        make_move_unsafe<Color::white>(mv, pos_hash);
+                else
+                        make_move_unsafe<Color::black>(mv, pos_hash);
+                seen.push_back(pos_hash.hash);
+        };
+        for (const Move mv : line)
+                play(mv);
+
+        while (line.size() < length) {
+                const TransTable::Node *node = tt.find(pos_hash.hash);
+                if (node == nullptr || node->depth_searched == 0)
+                        break;
+
+                // the entry may be of another position with the same hash, so the move must be legal
+                MoveList moves;
+                if (pos_hash.pos.meta.active == Color::white)
+                        generate_moves<Color::white>(pos_hash.pos, moves);
+                else
+                        generate_moves<Color::black>(pos_hash.pos, moves);
+                if (std::ranges::find(moves, node->best_move) == moves.end())
+                        break;
+
+                line.push_back(node->best_move);
+                play(node->best_move);
+                if (std::ranges::count(seen, pos_hash.hash) > 1)
+                        break;
         }
 }
 
+auto Engine::search (int depth) -> void
+{
+        forget_restricted_root();
+
+        // the search keeps its line in the arguments of the first worker
+        thread_pool.make_threads(1);
+        ThreadArgs &targs = thread_pool.worker_args[0];
+        targs.history.reset(hashes_excluding_root);
+        targs.pv.previous.clear();
+        targs.pv.matching = 0;
+        targs.positions_so_far.clear();
+        targs.pawn_table.reset_stats();
+        targs.eval_cache.reset_stats();
+        targs.lazy_eval_exits = 0;
+        targs.lazy_eval_calls = 0;
+        targs.run = true;
+        time_manager.reset();
+        deadline.reset();
+        node_limit.reset();
+        mate_limit.reset();
+        reset_node_count();
+
+        search_start_timepoint = std::chrono::steady_clock::now();
+        iterative_deepen_thread<false>(0, depth, targs.run);
+        targs.run = false;
+}
+
 /*
 auto Engine::position (const Position &pos) -> void
 {
@@ -177,18 +376,25 @@ auto Engine::go (const GoArgs &args) -> void
         if (running())
                 return;
 
+        // the clock runs from here
+        search_start_timepoint = std::chrono::steady_clock::now();
+
+        // the last search may have ended by itself, and then its worker is still to be joined
+        stop();
+        forget_restricted_root();
+
         // todo
 
+        // the legal moves, the restriction moves must be some of them
+        MoveList allowed_moves;
+        if (active_color() == Color::white)
+                generate_moves<Color::white>(root.pos, allowed_moves);
+        else
+                generate_moves<Color::black>(root.pos, allowed_moves);
+
         // add restriction moves if applicable
         this->restricted_moves.clear();
         if (args.move_list) {
-                // we verify the moves
-                MoveList allowed_moves;
-                if (active_color() == Color::white)
-                        generate_moves<Color::white>(root.pos, allowed_moves);
-                else
-                        generate_moves<Color::black>(root.pos, allowed_moves);
-
                 // all valid moves are in the allowed moves list
                 auto is_valid = [&] (Move mv) -> bool {
                         return std::ranges::any_of(allowed_moves, [&](Move allowed) {
@@ -202,6 +408,8 @@ auto Engine::go (const GoArgs &args) -> void
                         }
                 }
         }
+        if (!restricted_moves.empty())
+                restricted_root_hash = root.hash;
 
         // if we are pondering, the position is "fake" in the sense that
         // it only becomes real if the opponent plays the "pomdering" move that was given in position
@@ -214,38 +422,61 @@ auto Engine::go (const GoArgs &args) -> void
 
         // calculation time
         std::optional<std::chrono::milliseconds> calculation_time;
+        time_manager.reset();
+
+        const bool is_white = active_color() == Color::white;
+        const std::optional<size_t> time_left = is_white ? args.wtime : args.btime;
 
         if (args.move_time) {
                 // the time is given in milliseconds
                 calculation_time = std::chrono::milliseconds(*args.move_time);
-        } else if (args.infinite) {
+        } else if (args.infinite || args.ponder || !time_left) {
                 calculation_time = std::nullopt;
         } else {
                 // calculate time
-
-                calculation_time = std::nullopt;
+                // the time manager stops between iterations, the deadline is only the hard limit
+                const size_t increment = (is_white ? args.winc : args.binc).value_or(0);
+                const size_t num_root_moves = restricted_moves.empty() ? allowed_moves.size() : restricted_moves.size();
+                time_manager.emplace(TimeManager::Millis(*time_left), TimeManager::Millis(increment),
+                        args.moves_togo, num_root_moves);
+                calculation_time = std::chrono::duration_cast<std::chrono::milliseconds>(time_manager->hard_limit());
         }
 
-        // set hashes
+        // set hashes, the threads must exist for that
+        thread_pool.make_threads(1);
         for (size_t t = 0; t < thread_pool.num_threads; ++t) {
                 ThreadArgs &targs = thread_pool.worker_args[t];
-                // targs.hashes_so_far = hashes_excluding_root;
-                targs.hashes_so_far.clear();
+                targs.history.reset(hashes_excluding_root);
+                targs.pv.previous.clear();
+                targs.pv.matching = 0;
                 targs.positions_so_far.clear();
+                targs.pawn_table.reset_stats();
+                targs.eval_cache.reset_stats();
+                targs.lazy_eval_exits = 0;
+                targs.lazy_eval_calls = 0;
         }
 
 
-        if (calculation_time) {
-                stop_after(*calculation_time);
-        }
+        node_limit = args.nodes;
+        mate_limit = args.mate_in;
+        reset_node_count();
+
+        // the search itself checks the deadline every few nodes
+        deadline.reset();
+        if (calculation_time)
+                deadline = search_start_timepoint + *calculation_time;
 
 
         int max_depth = args.depth.value_or(Engine::depth_max);
 
+        // a mate in n moves is 2n - 1 plies, and one more to see that the mated side has no moves
+        // so deeper does not find more
+        if (mate_limit)
+                max_depth = std::min<int>(max_depth, 2 * static_cast<int>(std::clamp<size_t>(*mate_limit, 1, max_mate_ply)));
+
         // if args.infinity is set, or args.move_time is not given
         // we calculate indefinately
 
-        search_start_timepoint = std::chrono::steady_clock::now();
         this->should_send_best_move = true;
 
         // depending on if we have restricted moves
@@ -256,79 +487,13 @@ auto Engine::go (const GoArgs &args) -> void
         }
 }
 
-auto Engine::stop_after (std::chrono::milliseconds dur) -> void
-{
-        auto time_stop_worker = [this]() -> void {
-                const std::shared_ptr to_args = this->thread_pool.to_clock_args;
-                while (true) {
-                        if (to_args->cancel)
-                                return;
-
-                        const auto now = std::chrono::steady_clock::now();
-
-                        if (now >= to_args->stop_time) {
-                                // we stop the engine
-                                this->stop();
-                                return;
-                        }
-                        std::this_thread::sleep_for(std::chrono::microseconds(500));
-                }
-        };
-
-        // there are 2 cases, either there is already a timer thread active, or not
-        // if not, we make a new struct, otherwise we update the other one
-
-        if (this->thread_pool.to_clock_args) {
-                // already exists
-                this->thread_pool.to_clock_args->cancel = true;
-                // now we wait for the thread to exit
-                while (this->thread_pool.to_clock_args.use_count() > 1)
-                        std::this_thread::yield();
-
-        } else {
-                // make new one
-                this->thread_pool.to_clock_args = std::make_shared<ThreadPool::TimedEngineStopArgs>();
-        }
-
-        this->thread_pool.to_clock_args->cancel = false;
-        this->thread_pool.to_clock_args->stop_time = std::chrono::steady_clock::now() + dur;
-
-        std::thread(time_stop_worker).detach();
-}
-
-auto Engine::launch_worker_killer () -> void
-{
-        auto worker_killer = [this]() -> void {
-                // we copy these args so that the shared_ptr shows a different user
-                const std::shared_ptr to_args = this->thread_pool.to_clock_args;
-                this->stop();
-        };
-
-        // if there is a timer thread active, we cancel that
-
-        if (this->thread_pool.to_clock_args) {
-                // already exists
-                this->thread_pool.to_clock_args->cancel = true;
-                // now we wait for the thread to exit
-                while (this->thread_pool.to_clock_args.use_count() > 1)
-                        std::this_thread::yield();
-
-        } else {
-                // make new one
-                this->thread_pool.to_clock_args = std::make_shared<ThreadPool::TimedEngineStopArgs>();
-        }
-
-        this->thread_pool.to_clock_args->cancel = false;
-        std::thread(worker_killer).detach();
-}
-
-
 auto Engine::running() const -> bool
 {
-        const std::thread *begin = this->thread_pool.worker_threads.get();
-        const std::thread *end = begin + this->thread_pool.num_threads;
-        return std::any_of(begin, end, [](const std::thread &t) -> bool {
-                return !is_idle(t);
+        // a worker that is done clears its flag, it may not be joined yet
+        const ThreadArgs *begin = this->thread_pool.worker_args.get();
+        const ThreadArgs *end = begin + this->thread_pool.num_threads;
+        return std::any_of(begin, end, [](const ThreadArgs &targs) -> bool {
+                return targs.run;
         });
 }
 
@@ -6,46 +6,62 @@
 #include "../cli/cli-utils.h"
 
 #include "eval.h"
+#include "nnue.h"
 #include "transtable.h"
 #include "zobrist-hash.h"
 #include "gen-defs.h"
 #include "movegen.h"
+#include "repetition.h"
+#include "pv-table.h"
+#include "time-manager.h"
 #include <cassert>
 #include <thread>
 #include <memory>
 
 #include <mutex>
+#include <atomic>
 
 
 
 struct ThreadArgs {
-        bool run;
+        // the search of the thread goes on until this is cleared, by the thread itself or by any other
+        std::atomic<bool> run = false;
 
-        // contains the hashes of positions in the line we are looking at
-        // not the ones already played on the board
+        // the hashes of the positions played on the board and of the line we are looking at
         // used for the repetition rule
-        std::vector<uint64_t> hashes_so_far;
+        RepetitionHistory history;
+
+        // the best line from every node of the current line
+        PvTable pv;
 
         // todo
         std::vector<Position> positions_so_far;
-};
 
-const auto empty_thread_id = std::thread::id{};
-inline auto is_idle (const std::thread &t) {return t.get_id() == empty_thread_id;}
+        // caches the pawn structure terms of the static eval
+        PawnTable pawn_table;
 
-struct ThreadPool {
+        // caches whole static evals
+        EvalCache eval_cache;
 
-        // the engine can start up a search, and than run for 'x' milliseconds
-        // after that, a thread stops the engine
+        // how many leaves skipped the expensive part of the eval
+        size_t lazy_eval_exits = 0;
+        size_t lazy_eval_calls = 0;
 
-        struct TimedEngineStopArgs {
-                typedef std::chrono::time_point<std::chrono::steady_clock> time_point_t;
+        // the accumulators of the network along the current line, only used with the network
+        Nnue::AccumulatorStack accumulators;
 
-                time_point_t stop_time;
-                bool cancel = false;
-        };
+        // whether eval_cache holds evals of the network or of the classical eval
+        bool cache_holds_network_evals = false;
+
+        // the nodes left until this thread adds the ones it searched to the count of all threads
+        size_t nodes_to_poll = 0;
+        size_t poll_batch = 0;
+};
 
-        std::shared_ptr<TimedEngineStopArgs> to_clock_args = nullptr;
+const auto empty_thread_id = std::thread::id{};
+inline auto is_idle (const std::thread &t) {return t.get_id() == empty_thread_id;}
+
+struct ThreadPool {
 
         std::unique_ptr<std::thread[]> worker_threads = nullptr;
         std::unique_ptr<ThreadArgs[]>  worker_args    = nullptr;
@@ -84,16 +100,6 @@ struct ThreadPool {
                 }
                 return false;
         }
-
-        ~ThreadPool()
-        {
-                if (to_clock_args) {
-                        to_clock_args->cancel = true;
-                        while (to_clock_args.use_count() > 1) {
-                                std::this_thread::yield();
-                        }
-                }
-        }
 };
 
 // when their engine wants to send info, this is what it is
@@ -104,7 +110,7 @@ struct SendInfoArgs {
         std::optional<uint64_t> time_ms = std::nullopt;
         std::optional<uint64_t> nodes   = std::nullopt;
         std::optional<std::vector<Move>> pv = std::nullopt;
-        // no multipv
+        std::optional<size_t> multipv = std::nullopt;   // the rank of this line, with more than one
         struct Score {
                 int engine_perspective; // in centi_pawns
                 std::optional<int> mate = std::nullopt;
@@ -119,7 +125,8 @@ struct SendInfoArgs {
         // no tbhits
         // no cpuloads
 
-        // no other infostrings
+        // free text, only sent in debug mode
+        std::optional<std::string> string = std::nullopt;
 
         Color active_color;
 };
@@ -158,28 +165,37 @@ public:
 
                 // stop any threads if they are running
                 stop();
-
-                // there may be some detached thread
-
-                if (thread_pool.to_clock_args) {
-                        thread_pool.to_clock_args->cancel = true;
-                        while (thread_pool.to_clock_args.use_count() > 1)
-                                std::this_thread::yield();
-                }
         }
 
         struct Options {
                 size_t num_threads = 1;
+                bool debug = false;     // sends extra info strings
+                bool use_nnue = false;  // evaluates with the network instead of static_eval, if one is loaded
+                size_t multi_pv = 1;    // the number of best lines from the root that are searched and sent
         } opts;
 
         auto options() -> auto & {return opts;}
 
+        // the network for use_nnue, nullptr to remove it
+        auto set_network (std::unique_ptr<Nnue::Network> net) -> void;
+        auto has_network () const -> bool {return network != nullptr;}
+
         // fills the table until depth (no threads)
         auto fill (int depth) {fill_alpha_beta(depth);}
 
         // no threads
         auto iterative_deepen(int start_ply, int max_ply) -> void;
 
+        // iteratively deepens up to depth on the calling thread, and returns when done
+        auto search (int depth) -> void;
+        auto nodes_searched () const -> size_t {return total_nodes_searched;}
+
+        // the pv of the last finished iteration
+        auto principal_variation () const -> std::vector<Move>
+        {
+                return thread_pool.empty() ? std::vector<Move>{} : thread_pool.worker_args[0].pv.previous;
+        }
+
         // these functions return the eval/move RIGHT NOW,
         // without regards for what the engine is doing
         auto demand_eval () const -> std::optional<Eval>;
@@ -228,18 +244,18 @@ private:
         template <bool root_restricted = false>
         auto start_iterative_deepen (int max_depth = depth_max) -> void;
 
-        // launches a thread that makes the engine stop after "dur" milliseconds
-        auto stop_after (std::chrono::milliseconds dur) -> void;
+        // clears the run flags of all workers, they unwind from wherever they are in the search
+        auto stop_workers () -> void;
 
-        // launches a thread that makes the engine stop now
-        // the workers can launch this when they are done
-        auto launch_worker_killer () -> void;
+        // sends the best move, only the first time after go
+        // the worker that ends the search calls it, and stop() as well
+        auto send_best_move_once () -> void;
 
         // the function that iteratively deepens the search
         // if the template parameter "restrict_root" is set, the root node will use
         // the moves in this->restricted_moves
         template <bool restrict_root = false>
-        auto iterative_deepen_thread (int start_depth, int max_depth, const bool &run) -> void;
+        auto iterative_deepen_thread (int start_depth, int max_depth, const std::atomic<bool> &run) -> void;
 
 
         // no threads
@@ -256,7 +272,7 @@ private:
         // respects the root restriction if applicable
         // like the normal one, but the "run" parameter tells them when to stop
         template <bool restrict_root = false>
-        auto fill_alpha_beta_thread (int depth, const bool &run) -> void;
+        auto fill_alpha_beta_thread (int depth, const std::atomic<bool> &run) -> void;
         // auto fill_alpha_beta_restrict_thread (int ply, const bool &run) -> void;
 
 
@@ -264,13 +280,32 @@ private:
 
         // the actual recursive function
         template <Color col>
-        auto alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval beta, int depth_left, const bool &run) -> Eval;
+        auto alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval beta, int depth_left, const std::atomic<bool> &run) -> Eval;
 
         // this function is like the normal alpha-beta function
         // but the only moves made from the root position are the moves in MoveList this->restricted_moves
         // these are assumed to be valid for the root position in this functions
         template <Color col>
-        auto alpha_beta_restricted_root_col (int depth_left, const bool &run) -> Eval;
+        auto alpha_beta_restricted_root_col (int depth_left, const std::atomic<bool> &run) -> Eval;
+
+        // a line from the root with its eval
+        struct RootLine {
+                Eval eval;
+                std::vector<Move> pv;
+        };
+
+        // the best opts.multi_pv lines from the root, best first
+        // every line is a restricted root search without the first moves of the lines before it,
+        // so the later ones mostly hit the nodes of the earlier ones in the table
+        template <Color col>
+        auto multi_pv_root_col (int depth, const std::atomic<bool> &run) -> std::vector<RootLine>;
+
+        // extends a line from the root with the best moves in the table, up to "length" moves
+        // a line that ends in a hit of the table has no more moves in the pv table
+        auto complete_line (std::vector<Move> &line, size_t length) const -> void;
+
+        // the score of an eval of the root for the info, from the side to move
+        auto root_score (Eval eval, TransTable::Node::NodeType ntype) const -> SendInfoArgs::Score;
 
         // makes an entry in the right bucket in the transposition table
         // chooses which one to overwrite if needed
@@ -285,6 +320,30 @@ private:
 
         auto active_color() const -> Color {return root.pos.meta.active;}
 
+        // the network the search evaluates with, nullptr for the classical eval
+        auto active_network () const -> const Nnue::Network * {return opts.use_nnue ? network.get() : nullptr;}
+
+        // readies the eval caches and the accumulators of a thread for a search from the root
+        auto prepare_eval (ThreadArgs &targs) -> void;
+
+        // the pv of the search that a thread just finished
+        // if the root was a hit in the table there is none, and then it is the move of the table
+        auto root_line (const ThreadArgs &targs) const -> std::vector<Move>;
+
+        // whether to stop after an iteration with this result,
+        // because it is the mate that go mate looks for or the time manager says so
+        auto iteration_ends_search (Move best_move, Eval eval) -> bool;
+
+        // the threads count the nodes of a new search from 0
+        auto reset_node_count () -> void;
+
+        // adds the nodes of a thread to the count of all threads,
+        // and stops them all at the node limit or at the deadline
+        auto poll_limits (ThreadArgs &targs) -> void;
+
+        // the nodes of all threads since the search started, a few of the last ones may be missing
+        auto searched_nodes () const -> size_t;
+
 
 
         // Position root;
@@ -296,6 +355,8 @@ private:
 
         TransTable tt;
 
+        std::unique_ptr<Nnue::Network> network = nullptr;
+
 
         // gen of the current move, every time a move is made, this is incremented
         uint64_t current_gen;
@@ -305,6 +366,12 @@ private:
         MoveList restricted_moves;
         auto root_restrictions () -> auto & {return restricted_moves;}
 
+        // the root of the last search with restricted moves, its entry in the table is only about those moves
+        std::optional<uint64_t> restricted_root_hash;
+
+        // removes that entry, so no later search takes it for the whole position
+        auto forget_restricted_root () -> void;
+
 
         bool pondering = false;
 
@@ -323,18 +390,35 @@ private:
         // timepoint the search started
         std::chrono::time_point<std::chrono::steady_clock> search_start_timepoint;
 
+        // only if the search plays on a clock, it stops the search between iterations
+        std::optional<TimeManager> time_manager;
+
+        // a thread polls the limits this often, a node limit is never overshot
+        // and this many nodes take well under a millisecond, which is how late the search sees the deadline
+        static constexpr size_t node_poll_interval = 512;
+
+        // the nodes the threads have polled since the search started
+        std::atomic<size_t> polled_nodes = 0;
+
+        // go movetime, or the hard limit of the time manager
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+
+        // go nodes, the search stops after this many nodes
+        std::optional<size_t> node_limit;
+
+        // go mate, the search stops when it finds a mate in at most this many moves
+        std::optional<size_t> mate_limit;
+
         // function to send info
         void (* send_info)(const SendInfoArgs &info_args);
 
         // function to send bestmove
         void (* send_bestmove)(Move mv, Color col);
 
-        bool should_send_best_move = false;
-        bool workers_should_kill_themselves = false;
+        std::atomic<bool> should_send_best_move = false;
 
         // for testing functions
         friend auto test_nodegen () -> void;
-        friend auto test_threads () -> void;
         friend auto test_resize () -> void;
 };
 
@@ -363,7 +447,7 @@ auto Engine::get_node_writer(uint64_t hash) -> TransTable::NodeWriter<col>
 
 
 template <Color col>
-auto Engine::alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval beta, int depth_left, const bool &run) -> Eval
+auto Engine::alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval beta, int depth_left, const std::atomic<bool> &run) -> Eval
 {
         // todo pass as parameter, for multithreading
         constexpr int thread_id = 0;
@@ -388,11 +472,28 @@ auto Engine::alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval
 
         const uint64_t &hash  = pos_hash.hash;
 
-        // the hashes of the positions that have already been made on the board
-        const std::vector<uint64_t> &made_hashes = this->hashes_excluding_root;
+        ThreadArgs &targs = thread_pool.worker_args[thread_id];
+        const Nnue::Network *const network = active_network();
+
+        // the count of all threads is only touched once in a while
+        if (--targs.nodes_to_poll == 0)
+                poll_limits(targs);
+
 
-        // the hashes of the current line
-        std::vector<uint64_t> &encountered_hashes = thread_pool.worker_args[thread_id].hashes_so_far;
+        // the distance to the root, and this node has no line until it has a best move
+        const size_t ply = targs.history.line_length();
+        targs.pv.clear(ply);
+
+        // mate distance pruning
+        // the window is relative to this node, so if the parent only takes a mate right now,
+        // the side to move can not do that and the best it could do is mate in 1 ply, which is worse
+        if constexpr (is_white) {
+                if (alpha == worst_black)
+                        return worst_black - 1;
+        } else {
+                if (beta == worst_white)
+                        return worst_white + 1;
+        }
 
         // first, we have to make a place in the transposition table
         TransTable::NodeWriter<col> proxy = get_node_writer<col>(hash);
@@ -416,18 +517,10 @@ auto Engine::alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval
         // solution: something like proxy.mark_repeat() and proxy.is_repeat()?'
         // or at least, when we hit a node we want to not blindly make the move if it is indeed a repetition
 
-        const int already_reached = [&]() -> int {
-                int n = 0;
-                for (const uint64_t &h : made_hashes) {
-                        if (h == hash) {
-                                ++n;
-                        }
-                }
-                return n;
-        }();
-
-        // already encountered this in the hypothetical line
-        const bool encountered_hypo = std::ranges::any_of(encountered_hashes, [&](const uint64_t &x) {return x == hash;});
+        // the earlier positions on the board and in this line, only since the last capture or pawn move
+        const RepetitionHistory::Repetitions reps = targs.history.count(hash, pos_hash.pos.meta.passive_move_counter);
+        const int already_reached = reps.on_board;
+        const bool encountered_hypo = reps.in_line > 0;
 
         // if there is only one encounter we just ignore it
         if (already_reached >= 2) {
@@ -447,22 +540,9 @@ auto Engine::alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval
                 return 0;
         }
         
-        // we want to add this position to the hash vector
-        // so use a constructor/destructor pair for ease
-        struct AddHash{
-                AddHash (std::vector<uint64_t> &vec, uint64_t hash)
-                        : hashes(vec)
-                {
-                        hashes.emplace_back(hash);
-                }
-                ~AddHash ()
-                {
-                        hashes.pop_back();
-                }
-                std::vector<uint64_t> &hashes;
-        } _(encountered_hashes, hash);
+        // this position is part of the line until we return
+        const RepetitionHistory::Guard _(targs.history, hash);
 
-        
         // if we hit a position, either it has already been calculated in sufficient depth,
         // or not. In that case, we'll still believe that top move is worth trying out first,
         // because that is smart with the alpha-beta pruning
@@ -473,27 +553,10 @@ auto Engine::alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval
         // if this eval is some limit that is outside the alpha-beta window, we are done as well
         if (hit && proxy.original_depth() >= depth_left) {
 
-                // there is a chance that the move we are about to make blindly
-                // is a threefold repetition, making a draw in a winning position
-                // this happens when this position stays in the tabld, without being updated
-                // we have to check, before returning, if this move will be repetition
-
-                Move mv = proxy.original_move();
-                auto next_pos = pos_hash;
-                make_move_unsafe<col>(mv, next_pos);
-                size_t counter = 0;
-                for (const auto &h : made_hashes) {
-                        if (h == hash) {
-                                ++counter;
-                        }
-                }
-                for (const auto &h : encountered_hashes) {
-                        if (h == hash) {
-                                ++counter;
-                        }
-                }
-
-                if (counter < 2) {
+                // the stored eval may come from before this position was played on the board,
+                // when it was not yet on its way to a threefold repetition
+                // so we only trust it if the position has not been played before
+                if (already_reached == 0) {
                         const typename TransTable::NodeWriter<col>::BoundedEval bounded_eval = proxy.original_eval();
 
                         if (bounded_eval.ntype == TransTable::Node::NodeType::exact) {
@@ -523,8 +586,33 @@ auto Engine::alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval
 
         if (depth_left == 0) {
 
-                const Eval eval = static_eval(pos_hash.pos);
-                proxy.write_static_eval(eval);
+                // a cached eval is always exact
+                // otherwise the classical eval may exit early, when it is far enough outside of the window
+                Eval eval;
+                if (const std::optional<Eval> cached = targs.eval_cache.find(hash)) {
+                        assert(*cached == (network ? Nnue::evaluate(*network, pos_hash.pos) : static_eval(pos_hash.pos)));
+                        eval = *cached;
+                        proxy.write_static_eval(eval);
+                } else if (network) {
+                        // the accumulator of this position is on top of the stack
+                        eval = Nnue::evaluate(*network, targs.accumulators.top(), col);
+                        assert(eval == Nnue::evaluate(*network, pos_hash.pos));
+                        targs.eval_cache.store(hash, eval);
+                        proxy.write_static_eval(eval);
+                } else {
+                        const LazyEval lazy = lazy_static_eval(pos_hash, targs.pawn_table, alpha, beta);
+                        eval = lazy.eval;
+                        targs.lazy_eval_calls++;
+                        if (lazy.exact) {
+                                targs.eval_cache.store(hash, eval);
+                                proxy.write_static_eval(eval);
+                        } else {
+                                // only a bound, so the node says so as well
+                                targs.lazy_eval_exits++;
+                                const auto ntype = eval > beta ? TransTable::Node::lowerbound : TransTable::Node::upperbound;
+                                proxy.write_eval(ntype, 0, eval, {});
+                        }
+                }
                 proxy.flush();
 
                 // best move is not initialised, because if depth-searched is 0, this is not important anyway
@@ -552,7 +640,8 @@ auto Engine::alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval
         // the node holds a valid move if we have a hit, and the eval is not mate and depth > 0
         // swap the best move with the front move, if applicable
         // paranoia: we check if this is indeed a legal move before we do nonsense moves
-        if (hit && proxy.original_eval().eval != worst && proxy.original_depth() > 0) {
+        // a stalemate has no moves at all, and so no best move either
+        if (hit && !move_list.empty() && proxy.original_eval().eval != worst && proxy.original_depth() > 0) {
                 const Move prev_best_move = proxy.original_move();
 
                 // swap with front in the list if it indeed exists
@@ -573,6 +662,15 @@ auto Engine::alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval
                 }
         }
 
+        // along the pv of the previous iteration its move goes first, even before the move of the table
+        // the table may have lost that node already
+        const std::optional<Move> previous_pv_move = targs.pv.previous_move(ply);
+        if (previous_pv_move) {
+                const auto it = std::ranges::find(move_list, *previous_pv_move);
+                if (it != move_list.end())
+                        std::rotate(move_list.begin(), it, it + 1);
+        }
+
         // if the final eval ends up in the window, the eval is exact
         // if the final eval ends up worse than the window, it is only a upper bound(white) / lower bound(black)
         //      because the other color WILL have done a cut-off
@@ -600,10 +698,19 @@ auto Engine::alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval
         for (const Move mv : move_list) {
                 PositionHashPair poshash_after_move = pos_hash;
                 make_move_unsafe<col>(mv, poshash_after_move);
-                const Eval sub_eval = alpha_beta_col<!col>(poshash_after_move, alpha, beta, depth_left - 1, run);
+                if (network)
+                        targs.accumulators.push(*network, pos_hash.pos, poshash_after_move.pos);
+                if (previous_pv_move && mv == *previous_pv_move)
+                        targs.pv.matching = ply + 1;
+                const Eval sub_eval = add_ply(alpha_beta_col<!col>(poshash_after_move, remove_ply(alpha), remove_ply(beta), depth_left - 1, run));
+                if (previous_pv_move)
+                        targs.pv.matching = ply;
+                if (network)
+                        targs.accumulators.pop();
                 if (eval_is_better(sub_eval)) {
                         eval = sub_eval;
                         best_mv = mv;
+                        targs.pv.update(ply, mv);
                 }
 
                 // if the move is "too good", the other player could have already prevented it by force
@@ -633,13 +740,6 @@ auto Engine::alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval
                 }
         }
 
-        // if the eval is mate, we need to increase the ply of the mate
-        if (white_is_mated(eval)) {
-                ++eval;
-        } else if (black_is_mated(eval)) {
-                --eval;
-        }
-
         // if there are no moves we are mated
         // or there is stalemate, in which case we have eval 0
 
@@ -695,7 +795,7 @@ auto Engine::alpha_beta_col (const PositionHashPair &pos_hash, Eval alpha, Eval
 
 // special case where the moves are already made
 template <Color col>
-auto Engine::alpha_beta_restricted_root_col (int depth_left, const bool &run) -> Eval
+auto Engine::alpha_beta_restricted_root_col (int depth_left, const std::atomic<bool> &run) -> Eval
 {
         this->total_nodes_searched++;
 
@@ -709,11 +809,9 @@ auto Engine::alpha_beta_restricted_root_col (int depth_left, const bool &run) ->
 
         bool entry_was_in_use = false;
 
+        // the entry may be of other root moves, of another searchmoves or of an earlier multipv line,
+        // so it is not used for a cut-off, the children are mostly hits anyway
         if (to_contents) {
-                if (to_contents->depth_searched >= depth_left) {
-                        to_contents->gen = current_gen;
-                        return to_contents->eval;
-                }
                 entry_was_in_use = to_contents->in_use;
 
         } else {
@@ -734,6 +832,20 @@ auto Engine::alpha_beta_restricted_root_col (int depth_left, const bool &run) ->
         Eval eval = worst;
         Move best_move = move_list[0];  // assume there is something there
 
+        ThreadArgs &targs = thread_pool.worker_args[0];
+        const Nnue::Network *const network = active_network();
+
+        // like in alpha_beta_col, the root is part of the line
+        const RepetitionHistory::Guard _(targs.history, hash);
+        targs.pv.clear(0);
+
+        // the first move of the previous pv goes first again
+        if (const std::optional<Move> previous_pv_move = targs.pv.previous_move(0)) {
+                const auto it = std::ranges::find(restricted_moves, *previous_pv_move);
+                if (it != restricted_moves.end())
+                        std::rotate(restricted_moves.begin(), it, it + 1);
+        }
+
         auto is_better = [&] (Eval ev) -> bool {
                 return white_black<col>(ev > eval, ev < eval);
         };
@@ -745,10 +857,18 @@ auto Engine::alpha_beta_restricted_root_col (int depth_left, const bool &run) ->
 
                 PositionHashPair poshash_after_move = this->root;
                 make_move_unsafe<col>(mv, poshash_after_move);
-                const Eval sub_eval = alpha_beta_col<!col>(poshash_after_move, alpha, beta, depth_left - 1, run);
+                if (network)
+                        targs.accumulators.push(*network, root.pos, poshash_after_move.pos);
+                if (targs.pv.previous_move(0) == mv)
+                        targs.pv.matching = 1;
+                const Eval sub_eval = add_ply(alpha_beta_col<!col>(poshash_after_move, remove_ply(alpha), remove_ply(beta), depth_left - 1, run));
+                targs.pv.matching = 0;
+                if (network)
+                        targs.accumulators.pop();
                 if (is_better(sub_eval)) {
                         eval = sub_eval;
                         best_move = mv;
+                        targs.pv.update(0, mv);
                 }
 
                 if constexpr (is_white) {
@@ -773,18 +893,74 @@ auto Engine::alpha_beta_restricted_root_col (int depth_left, const bool &run) ->
                 return 0;
         }
 
+        // exact for these moves only, go forgets it before the next search
         to_contents->hash = hash;
         to_contents->gen = current_gen;
         to_contents->eval = eval;
         to_contents->best_move = best_move;
         to_contents->depth_searched = depth_left;
+        to_contents->node_type = TransTable::Node::exact;
 
         return eval;
 }
 
+template <Color col>
+auto Engine::multi_pv_root_col (int depth, const std::atomic<bool> &run) -> std::vector<RootLine>
+{
+        // all legal moves, or those of searchmoves
+        const bool was_restricted = !restricted_moves.empty();
+        MoveList searched_moves = restricted_moves;
+        if (!was_restricted)
+                generate_moves<col>(root.pos, searched_moves);
+
+        ThreadArgs &targs = thread_pool.worker_args[0];
+        std::vector<RootLine> lines;
+        MoveList remaining = searched_moves;
+        while (lines.size() < opts.multi_pv && !remaining.empty()) {
+                restricted_moves = remaining;
+                const Eval eval = alpha_beta_restricted_root_col<col>(depth, run);
+                if (!run)
+                        break;
+
+                // if every move is mated, no move was ever better and the first one counts
+                std::vector<Move> pv = targs.pv.line();
+                if (pv.empty())
+                        pv.push_back(restricted_moves[0]);
+
+                // the later lines mostly hit the nodes of the earlier ones, and then only have a first move
+                complete_line(pv, depth);
+
+                remaining.clear();
+                for (const Move mv : restricted_moves)
+                        if (mv != pv.front())
+                                remaining.push_back(mv);
+                lines.emplace_back(eval, std::move(pv));
+        }
+
+        // searchmoves still holds for the next iteration, and no restriction stays no restriction
+        if (was_restricted)
+                restricted_moves = searched_moves;
+        else
+                restricted_moves.clear();
+
+        // the root in the table is of the last line, but the best move is that of the first
+        if (!lines.empty()) {
+                if (TransTable::Node *to_root = tt.find(root.hash)) {
+                        to_root->eval = lines.front().eval;
+                        to_root->best_move = lines.front().pv.front();
+                        to_root->depth_searched = depth;
+                        to_root->node_type = TransTable::Node::exact;
+                        to_root->gen = current_gen;
+                }
+        }
+        return lines;
+}
+
 template <bool restrict_root>
-auto Engine::fill_alpha_beta_thread (int depth, const bool &run) -> void
+auto Engine::fill_alpha_beta_thread (int depth, const std::atomic<bool> &run) -> void
 {
+        prepare_eval(thread_pool.worker_args[0]);
+
         bool white_start = root.pos.meta.active == Color::white;
         if constexpr (restrict_root) {
                 if (white_start) {
@@ -802,55 +978,78 @@ auto Engine::fill_alpha_beta_thread (int depth, const bool &run) -> void
 }
 
 template <bool restrict_root>
-auto Engine::iterative_deepen_thread(int start_depth, int max_depth, const bool &run) -> void
+auto Engine::iterative_deepen_thread(int start_depth, int max_depth, const std::atomic<bool> &run) -> void
 {
-        while (run && start_depth <= max_depth) {
+        // a restricted root always makes its moves, at depth 0 its children would get a negative depth
+        if (restrict_root || opts.multi_pv > 1)
+                start_depth = std::max(start_depth, 1);
+
+        bool out_of_time = false;
+        while (run && !out_of_time && start_depth <= max_depth) {
                 ++current_gen;
-                fill_alpha_beta_thread<restrict_root>(start_depth++, run);
-                if (!run || send_info == nullptr)
+                ThreadArgs &targs = thread_pool.worker_args[0];
+
+                if (opts.multi_pv > 1) {
+                        // every line is sent, and the first one is the pv for the next iteration
+                        prepare_eval(targs);
+                        const int depth = start_depth++;
+                        const std::vector<RootLine> lines = active_color() == Color::white
+                                ? multi_pv_root_col<Color::white>(depth, run)
+                                : multi_pv_root_col<Color::black>(depth, run);
+                        if (!run || lines.empty())
+                                continue;
+
+                        targs.pv.previous = lines.front().pv;
+                        if (!lines.front().pv.empty())
+                                out_of_time = iteration_ends_search(lines.front().pv.front(), lines.front().eval);
+                        if (send_info == nullptr)
+                                continue;
+
+                        const auto dur = std::chrono::steady_clock::now() - search_start_timepoint;
+                        for (size_t k = 0; k < lines.size(); k++) {
+                                SendInfoArgs args;
+                                args.active_color = active_color();
+                                args.depth = depth;
+                                args.multipv = k + 1;
+                                args.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+                                args.nodes = searched_nodes();
+                                args.hashfull = filled_permille();
+                                args.score = root_score(lines[k].eval, TransTable::Node::exact);
+                                args.pv = lines[k].pv;
+                                send_info(args);
+                        }
                         continue;
+                }
 
-                // send info
-                SendInfoArgs args;
-                // todo pv
+                fill_alpha_beta_thread<restrict_root>(start_depth++, run);
+                if (!run)
+                        continue;
 
+                targs.pv.previous = root_line(targs);
                 const auto to_root = tt.find(root.hash);
-                if (to_root == nullptr)
+                if (to_root != nullptr && !targs.pv.previous.empty())
+                        out_of_time = iteration_ends_search(targs.pv.previous.front(), to_root->eval);
+                if (send_info == nullptr || to_root == nullptr)
                         continue;
 
+                // send info
+                SendInfoArgs args;
+                if (!targs.pv.previous.empty())
+                        args.pv = targs.pv.previous;
+
 
                 // time
                 std::chrono::duration dur = std::chrono::steady_clock::now() - search_start_timepoint;
                 args.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+                args.nodes = searched_nodes();
+                if (*args.time_ms > 0)
+                        args.nps = static_cast<int>(*args.nodes * 1000 / *args.time_ms);
 
                 Color active = active_color();
-                bool is_white = active == Color::white;
                 args.active_color = active;
                 args.hashfull = filled_permille();
                 args.depth = start_depth - 1;
 
-                SendInfoArgs::Score score;
-
-                score.engine_perspective = is_white ? to_root->eval : -to_root->eval;
-                score.lower_bound = to_root->node_type == TransTable::Node::lowerbound;
-                score.upper_bound = to_root->node_type == TransTable::Node::upperbound;
-                if (is_mate(to_root->eval)) {
-                        int num_plies;
-                        if (white_is_mated(to_root->eval))
-                                num_plies = to_root->eval - worst_white;
-                        else
-                                num_plies = worst_black - to_root->eval;
-
-                        bool opponent_is_mated = is_white == black_is_mated(to_root->eval);
-
-                        // the amount of moves to the mate, not plies
-                        // int num_moves = opponent_is_mated ? (1 + num_plies) / 2 : num_plies / 2;
-                        int num_moves = (1 + num_plies) / 2;
-
-                        score.mate = opponent_is_mated ? num_moves : -num_moves;
-                }
-
-                // args.pv =
                 /*
                 args.score = SendInfoArgs::Score{};
                 args.score->engine_perspective = active == Color::white ? request_eval() : -request_eval();
@@ -858,10 +1057,23 @@ auto Engine::iterative_deepen_thread(int start_depth, int max_depth, const bool
                 args.score->lower_bound = false;
                 args.score->upper_bound = false;
                 */
-                args.score = score;
+                args.score = root_score(to_root->eval, to_root->node_type);
 
                 send_info(args);
 
+                if (opts.debug) {
+                        auto hit_rate = [](const std::string &name, const auto &table) -> std::string {
+                                return name + " hits " + std::to_string(table.hits())
+                                        + " of " + std::to_string(table.probes()) + " probes ("
+                                        + std::to_string(table.probes() ? 100 * table.hits() / table.probes() : 0) + "%)";
+                        };
+                        SendInfoArgs debug_args;
+                        debug_args.active_color = active;
+                        debug_args.string = hit_rate("pawn table", targs.pawn_table) + ", " + hit_rate("eval cache", targs.eval_cache)
+                                + ", lazy eval exits " + std::to_string(targs.lazy_eval_exits) + " of " + std::to_string(targs.lazy_eval_calls);
+                        send_info(debug_args);
+                }
+
 
         }
 }
@@ -876,27 +1088,20 @@ auto Engine::start_iterative_deepen(int max_depth) -> void
 
         thread_pool.make_threads(1);
 
+        // it runs before the thread starts, so the engine is running as soon as go returns
+        std::atomic<bool> &thread_run = this->thread_pool.worker_args[0].run;
+        thread_run = true;
+
         // threads can't immediately bind to a member function
-        auto worker = [=] {
-                bool &thread_run = this->thread_pool.worker_args[0].run;
-                thread_run = true;
+        auto worker = [=, this, &thread_run] {
                 this->iterative_deepen_thread<restrict_root>(start_depth, max_depth, thread_run);
 
-                // if there is a maximum depth, and stop() is not called
-                // the threads are going to "float" around so to speak
-                // the threads can of course not stop themselves
-                // this function kills the worker(s), but can be called by the workers
-                if (this->workers_should_kill_themselves) {
-                        this->workers_should_kill_themselves = false;
-                        launch_worker_killer();
-                }
+                // the search ended by a limit or by stop(), either way the best move goes out right away
+                // the thread is joined by the next stop() or go()
+                thread_run = false;
+                send_best_move_once();
         };
 
-        // there is no other thread that is going to stop these threads when they have
-        // reached the desired depth
-        if (max_depth != Engine::depth_max)
-                this->workers_should_kill_themselves = true;
-
         thread_pool.worker_threads[0] = std::thread(worker);
 }
 
@@ -0,0 +1,46 @@
+// the heuristic constants of the classical eval, in centi pawn
+// the tuner (tools/tuner.cc) writes a file just like this one, which can replace it
+
+#ifndef EVAL_PARAMS_H
+#define EVAL_PARAMS_H
+
+// material
+constexpr int queen_val = 900;
+constexpr int rook_val = 500;
+constexpr int bishop_val = 350;
+constexpr int horse_val = 300;
+constexpr int pawn_val = 100;
+constexpr int pawn_val_eg = 120;
+
+// one piece on its square, _eg terms count in the endgame, the others in the midgame
+// rings are msk::ring, from the edge inwards, and advanced pawns are on the 6th and 7th rank
+constexpr int king_safety_lastrank_val = 40;
+constexpr int king_safety_2ndlastrank_val = 15;
+constexpr int king_ring_eg[4] = {-30, -10, 10, 20};
+constexpr int horse_ring_mg[4] = {-40, -20, 0, 20};
+constexpr int horse_ring_eg[4] = {-20, -10, 0, 10};
+constexpr int pawn_center_val = 15;
+constexpr int rook_file_pawn_penalty = 10;
+constexpr int pawn_advanced_mg[2] = {100, 150};
+constexpr int pawn_advanced_eg[2] = {150, 250};
+
+// activity and attacks
+constexpr int bishop_pair_bonus = 40;
+constexpr int par_square_attack_score = 4;
+constexpr int queen_attack_val = 40;
+constexpr int rook_attack_val = 30;
+constexpr int bishop_attack_val = 20;
+constexpr int horse_attack_val = 25;
+constexpr int pawn_attack_val = 5;
+constexpr int pawn_delta_attack_val = 10;
+constexpr int horse_pawn_bonus = 6;
+constexpr int bishop_pawn_penalty = 3;
+constexpr int unblocked_rook_score = 10;
+constexpr int king_open_area_penalty = 15;
+constexpr int attack_other_king_val = 40;
+
+// pawn structure
+constexpr int double_pawn_penalty = 20;
+constexpr int pawn_chain_defense_bonus = 10;
+
+#endif //EVAL_PARAMS_H
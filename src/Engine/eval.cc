@@ -3,3 +3,216 @@
 //
 
 #include "eval.h"
+#include <immintrin.h>
+
+namespace {
+
+// a vector of 64 bit lanes, one lane per position
+// arithmetic wraps around, so negative numbers work as int64
+#if defined(__AVX512F__) && defined(__AVX512DQ__) && defined(__AVX512VPOPCNTDQ__)
+struct Lanes {
+        static constexpr size_t width = 8;
+        __m512i v;
+
+        static auto load (const uint64_t *p) -> Lanes {return {_mm512_load_si512(p)};}
+        static auto set1 (int64_t x) -> Lanes {return {_mm512_set1_epi64(x)};}
+        auto store (int64_t *p) const -> void {_mm512_store_si512(p, v);}
+
+        friend auto operator& (Lanes a, Lanes b) -> Lanes {return {_mm512_and_si512(a.v, b.v)};}
+        friend auto operator| (Lanes a, Lanes b) -> Lanes {return {_mm512_or_si512(a.v, b.v)};}
+        friend auto operator+ (Lanes a, Lanes b) -> Lanes {return {_mm512_add_epi64(a.v, b.v)};}
+        friend auto operator- (Lanes a, Lanes b) -> Lanes {return {_mm512_sub_epi64(a.v, b.v)};}
+        friend auto operator* (Lanes a, Lanes b) -> Lanes {return {_mm512_mullo_epi64(a.v, b.v)};}
+        friend auto and_not (Lanes a, Lanes b) -> Lanes {return {_mm512_andnot_si512(b.v, a.v)};}
+        template <int n> friend auto shl (Lanes a) -> Lanes {return {_mm512_slli_epi64(a.v, n)};}
+        template <int n> friend auto shr (Lanes a) -> Lanes {return {_mm512_srli_epi64(a.v, n)};}
+        friend auto popcount (Lanes a) -> Lanes {return {_mm512_popcnt_epi64(a.v)};}
+        friend auto non_zero (Lanes a) -> Lanes {return {_mm512_maskz_set1_epi64(_mm512_test_epi64_mask(a.v, a.v), 1)};}
+};
+#elif defined(__AVX2__)
+struct Lanes {
+        static constexpr size_t width = 4;
+        __m256i v;
+
+        static auto load (const uint64_t *p) -> Lanes {return {_mm256_load_si256(reinterpret_cast<const __m256i *>(p))};}
+        static auto set1 (int64_t x) -> Lanes {return {_mm256_set1_epi64x(x)};}
+        auto store (int64_t *p) const -> void {_mm256_store_si256(reinterpret_cast<__m256i *>(p), v);}
+
+        friend auto operator& (Lanes a, Lanes b) -> Lanes {return {_mm256_and_si256(a.v, b.v)};}
+        friend auto operator| (Lanes a, Lanes b) -> Lanes {return {_mm256_or_si256(a.v, b.v)};}
+        friend auto operator+ (Lanes a, Lanes b) -> Lanes {return {_mm256_add_epi64(a.v, b.v)};}
+        friend auto operator- (Lanes a, Lanes b) -> Lanes {return {_mm256_sub_epi64(a.v, b.v)};}
+        // all products in the eval fit in 32 bits, so the signed 32 bit multiply is enough
+        friend auto operator* (Lanes a, Lanes b) -> Lanes {return {_mm256_mul_epi32(a.v, b.v)};}
+        friend auto and_not (Lanes a, Lanes b) -> Lanes {return {_mm256_andnot_si256(b.v, a.v)};}
+        template <int n> friend auto shl (Lanes a) -> Lanes {return {_mm256_slli_epi64(a.v, n)};}
+        template <int n> friend auto shr (Lanes a) -> Lanes {return {_mm256_srli_epi64(a.v, n)};}
+
+        // there is no popcount instruction, so each nibble is looked up and the bytes are summed
+        friend auto popcount (Lanes a) -> Lanes
+        {
+                const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+                const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+                const __m256i low = _mm256_and_si256(a.v, low_nibbles);
+                const __m256i high = _mm256_and_si256(_mm256_srli_epi16(a.v, 4), low_nibbles);
+                const __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high));
+                return {_mm256_sad_epu8(counts, _mm256_setzero_si256())};
+        }
+        friend auto non_zero (Lanes a) -> Lanes
+        {
+                return {_mm256_add_epi64(_mm256_set1_epi64x(1), _mm256_cmpeq_epi64(a.v, _mm256_setzero_si256()))};
+        }
+};
+#else
+struct Lanes {
+        static constexpr size_t width = 1;
+        uint64_t v;
+
+        static auto load (const uint64_t *p) -> Lanes {return {*p};}
+        static auto set1 (int64_t x) -> Lanes {return {static_cast<uint64_t>(x)};}
+        auto store (int64_t *p) const -> void {*p = static_cast<int64_t>(v);}
+
+        friend auto operator& (Lanes a, Lanes b) -> Lanes {return {a.v & b.v};}
+        friend auto operator| (Lanes a, Lanes b) -> Lanes {return {a.v | b.v};}
+        friend auto operator+ (Lanes a, Lanes b) -> Lanes {return {a.v + b.v};}
+        friend auto operator- (Lanes a, Lanes b) -> Lanes {return {a.v - b.v};}
+        friend auto operator* (Lanes a, Lanes b) -> Lanes {return {a.v * b.v};}
+        friend auto and_not (Lanes a, Lanes b) -> Lanes {return {a.v & ~b.v};}
+        template <int n> friend auto shl (Lanes a) -> Lanes {return {a.v << n};}
+        template <int n> friend auto shr (Lanes a) -> Lanes {return {a.v >> n};}
+        friend auto popcount (Lanes a) -> Lanes {return {static_cast<uint64_t>(bit_count(a.v))};}
+        friend auto non_zero (Lanes a) -> Lanes {return {a.v != 0};}
+};
+#endif
+
+// the bitboards of Lanes::width positions, one array per bitboard
+struct Block {
+        alignas(64) uint64_t pieces[12][Lanes::width];
+        alignas(64) uint64_t occupation[2][Lanes::width];       // indexed by color
+        alignas(64) uint64_t attacks[2][Lanes::width];
+        alignas(64) uint64_t king_area[2][Lanes::width];
+        alignas(64) int64_t piece_square[Lanes::width];
+};
+
+template <Color col>
+auto transpose_col (const Position &pos, Block &block, size_t lane) -> void
+{
+        constexpr int c = static_cast<int>(col);
+        block.occupation[c][lane] = pos.get_occupation<col>();
+        block.attacks[c][lane] = pos.attack_map<col>();
+        block.king_area[c][lane] = get_king_area(OneSquare_unsafe(pos.king<col>()));
+}
+
+auto transpose (std::span<const Position> positions, Block &block) -> void
+{
+        for (size_t lane = 0; lane < Lanes::width; lane++) {
+                // the lanes past the end are empty boards, and thrown away later
+                if (lane >= positions.size()) {
+                        for (auto &pieces : block.pieces)
+                                pieces[lane] = 0;
+                        for (int c = 0; c < 2; c++)
+                                block.occupation[c][lane] = block.attacks[c][lane] = block.king_area[c][lane] = 0;
+                        block.piece_square[lane] = 0;
+                        continue;
+                }
+
+                const Position &pos = positions[lane];
+                assert(pos.piece_square_is_consistent());
+                for (size_t pc = 0; pc < 12; pc++)
+                        block.pieces[pc][lane] = pos.board[pc];
+                transpose_col<Color::white>(pos, block, lane);
+                transpose_col<Color::black>(pos, block, lane);
+                block.piece_square[lane] = tapered(pos.piece_square_score, pos.phase);
+        }
+}
+
+// the files that contain a piece, in the lowest 8 bits
+auto occupied_files (Lanes f) -> Lanes
+{
+        f = f | shr<32>(f);
+        f = f | shr<16>(f);
+        f = f | shr<8>(f);
+        return f & Lanes::set1(0xff);
+}
+
+// eval_col and pawn_structure_col of col, for every lane
+template <Color col>
+auto eval_col_lanes (const Block &block) -> Lanes
+{
+        constexpr bool is_white = col == Color::white;
+        constexpr int c = static_cast<int>(col);
+        auto piece = [&](Epiece white_piece, Epiece black_piece) {
+                return Lanes::load(block.pieces[white_black<col>(white_piece, black_piece)]);
+        };
+        auto val = [](int64_t x) {return Lanes::set1(x);};
+
+        const Lanes atm = Lanes::load(block.attacks[c]);
+        const Lanes all_friendly = Lanes::load(block.occupation[c]);
+        const Lanes king_area = Lanes::load(block.king_area[c]);
+
+        const Lanes pawns   = piece(white_pawns, black_pawns),
+                    rooks   = piece(white_rooks, black_rooks),
+                    horses  = piece(white_horses, black_horses),
+                    bishops = piece(white_bishops, black_bishops);
+
+        const Lanes enemy_queens  = piece(black_queen, white_queen),
+                    enemy_pawns   = piece(black_pawns, white_pawns),
+                    enemy_rooks   = piece(black_rooks, white_rooks),
+                    enemy_horses  = piece(black_horses, white_horses),
+                    enemy_bishops = piece(black_bishops, white_bishops),
+                    enemy_king    = piece(black_king, white_king);
+
+        Lanes score = val(bishop_pair_bonus) * (non_zero(bishops & val(msk::white_squares)) & non_zero(bishops & val(msk::black_squares)));
+
+        score = score + val(par_square_attack_score) * popcount(atm);
+
+        score = score + val(queen_attack_val)  * popcount(atm & enemy_queens);
+        score = score + val(rook_attack_val)   * popcount(atm & enemy_rooks);
+        score = score + val(bishop_attack_val) * popcount(atm & enemy_bishops);
+        score = score + val(horse_attack_val)  * popcount(atm & enemy_horses);
+        score = score + val(pawn_attack_val)   * popcount(atm & enemy_pawns);
+
+        const Lanes all_pawns = popcount(pawns | enemy_pawns);
+        score = score + val(horse_pawn_bonus) * popcount(horses) * all_pawns;
+        score = score - val(bishop_pawn_penalty) * popcount(bishops) * all_pawns;
+
+        const Lanes pawn_files = occupied_files(pawns);
+        score = score + val(unblocked_rook_score) * popcount(and_not(occupied_files(rooks), pawn_files));
+
+        const Lanes pawns_east_attack = is_white ? shl<9>(pawns) & val(msk::LEFT) : shr<7>(pawns) & val(msk::LEFT);
+        const Lanes pawns_west_attack = is_white ? shl<7>(pawns) & val(msk::RIGHT) : shr<9>(pawns) & val(msk::RIGHT);
+        auto pawn_attacks = [&](Lanes enemies) {
+                return popcount(pawns_east_attack & enemies) + popcount(pawns_west_attack & enemies);
+        };
+        score = score + val(pawn_delta_attack_val * ((rook_val - 100) / 100)) * pawn_attacks(enemy_rooks);
+        score = score + val(pawn_delta_attack_val * ((queen_val - 100) / 100)) * pawn_attacks(enemy_queens);
+        score = score + val(pawn_delta_attack_val * ((horse_val - 100) / 100)) * pawn_attacks(enemy_horses);
+        score = score + val(pawn_delta_attack_val * ((bishop_val - 100) / 100)) * pawn_attacks(enemy_bishops);
+
+        score = score - val(king_open_area_penalty) * popcount(and_not(king_area, all_friendly));
+        score = score + val(attack_other_king_val) * non_zero(atm & enemy_king);
+
+        // the pawn structure, the doubled pawns are the pawns that are not the only one on their file
+        score = score - val(double_pawn_penalty) * (popcount(pawns) - popcount(pawn_files));
+        score = score + val(pawn_chain_defense_bonus) * pawn_attacks(pawns);
+
+        return score;
+}
+
+}
+
+auto static_eval_batch (std::span<const Position> positions, std::span<Eval> evals) -> void
+{
+        assert(evals.size() >= positions.size());
+
+        Block block;
+        alignas(64) int64_t scores[Lanes::width];
+        for (size_t begin = 0; begin < positions.size(); begin += Lanes::width) {
+                const std::span<const Position> chunk = positions.subspan(begin, std::min(Lanes::width, positions.size() - begin));
+                transpose(chunk, block);
+                (eval_col_lanes<Color::white>(block) - eval_col_lanes<Color::black>(block)).store(scores);
+                for (size_t lane = 0; lane < chunk.size(); lane++)
+                        evals[begin + lane] = truncated(static_cast<Eval>(block.piece_square[lane] + scores[lane]));
+        }
+}
@@ -3,7 +3,12 @@
 
 #include "position.h"
 #include "gen-defs.h"
+#include "zobrist-hash.h"
 #include <limits>
+#include <vector>
+#include <optional>
+#include <span>
+#include <algorithm>
 
 // we work with the ply of the mate, not number of "moves" because it is easier
 constexpr int max_mate_ply = 256;
@@ -27,6 +32,27 @@ inline auto truncated (Eval eval) -> Eval
         return eval;
 }
 
+// a mate one ply further away, the eval of a child seen from its parent
+inline auto add_ply (Eval eval) -> Eval
+{
+        if (white_is_mated(eval))
+                return eval + 1;
+        if (black_is_mated(eval))
+                return eval - 1;
+        return eval;
+}
+
+// the other way around, a bound of the parent passed on to a child
+// a mate right now has no ply to lose
+inline auto remove_ply (Eval eval) -> Eval
+{
+        if (white_is_mated(eval) && eval != worst_white)
+                return eval - 1;
+        if (black_is_mated(eval) && eval != worst_black)
+                return eval + 1;
+        return eval;
+}
+
 // returns true if from the perspective of col
 // the left eval is better than the right
 // this also works for mate in <n>
@@ -65,43 +91,164 @@ auto static_eval (const Position &board) -> Eval;
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-// heuristic constants
-// unit centi pawn
-constexpr int queen_val = 900;
-constexpr int rook_val = 500;
-constexpr int bishop_val = 350;
-constexpr int horse_val = 300;
-constexpr int pawn_val = 100;
-constexpr int par_square_attack_score = 4;
+// the heuristic constants are in eval-params.h
+
+
+// the files that contain a piece of f, bit i is file i
+constexpr
+auto occupied_files (Field f) -> uint8_t
+{
+        f |= f >> 32;
+        f |= f >> 16;
+        f |= f >> 8;
+        return static_cast<uint8_t>(f);
+}
+
+// the terms of the eval that only depend on the pawns
+// these change rarely between siblings, so they are cached in the PawnTable
+struct PawnEval {
+        Eval score = 0;                 // doubled pawns and pawn chains, white minus black
+        uint8_t white_open_files = 0xff; // files without a white pawn
+        uint8_t black_open_files = 0xff; // files without a black pawn
+
+        constexpr auto operator== (const PawnEval &other) const -> bool = default;
+};
+
+template <Color col>
+constexpr
+auto pawn_structure_col (const Position &board) -> Eval
+{
+        constexpr bool is_white = col == Color::white;
+        const Field &pawns = board.pawns<col>();
+
+        Eval score = 0;
+
+        int num_double_pawns = 0;
+        for (Field file = msk::file[0]; file; shift<east>(file)) {
+                const int num_pawns = bit_count(pawns & file);
+                if (num_pawns > 1) {
+                        num_double_pawns += num_pawns - 1;
+                }
+        }
+        score -= double_pawn_penalty * num_double_pawns;
+
+        // pawns get a bonus for defending another pawn
+        const Field pawns_east_attack = is_white ? shifted<northEast>(pawns) : shifted<southEast>(pawns);
+        const Field pawns_west_attack = is_white ? shifted<northWest>(pawns) : shifted<southWest>(pawns);
 
-// points for this piece being attacked
-constexpr int queen_attack_val = 40;
-constexpr int rook_attack_val = 30;
-constexpr int bishop_attack_val = 20;
-constexpr int horse_attack_val = 25;
-constexpr int pawn_attack_val = 5;
+        score += pawn_chain_defense_bonus * bit_count(pawns_east_attack & pawns);
+        score += pawn_chain_defense_bonus * bit_count(pawns_west_attack & pawns);
 
-// we like it when a pawn attacks something strong
-constexpr int pawn_delta_attack_val = 10;
+        return score;
+}
+
+constexpr
+auto pawn_structure_eval (const Position &board) -> PawnEval
+{
+        PawnEval pawn_eval;
+        pawn_eval.score = pawn_structure_col<Color::white>(board) - pawn_structure_col<Color::black>(board);
+        pawn_eval.white_open_files = ~occupied_files(board.pawns<Color::white>());
+        pawn_eval.black_open_files = ~occupied_files(board.pawns<Color::black>());
+        return pawn_eval;
+}
+
+// direct mapped cache of the pawn terms, keyed by the pawn hash
+// every search thread has its own, so no locking
+class PawnTable {
+public:
+        explicit PawnTable (size_t num_entries = 1 << 14)
+                : entries(std::bit_ceil(num_entries)),
+                  mask(entries.size() - 1)
+        { }
+
+        auto probe (const PositionHashPair &pos_hash) -> PawnEval
+        {
+                assert(pos_hash.pawn_hash == pawn_zobrist_hash(pos_hash.pos));
+
+                num_probes++;
+                Entry &entry = entries[pos_hash.pawn_hash & mask];
+                // an empty entry has key 0, which is the key of no pawns at all
+                // the default PawnEval is exactly right for that, so it is a valid hit as well
+                if (entry.key == pos_hash.pawn_hash) {
+                        num_hits++;
+                        assert(entry.eval == pawn_structure_eval(pos_hash.pos));
+                        return entry.eval;
+                }
 
-// bonus for a rook that doesn't look at a friendly pawn
-constexpr int unblocked_rook_score = 10;
+                entry.key = pos_hash.pawn_hash;
+                entry.eval = pawn_structure_eval(pos_hash.pos);
+                return entry.eval;
+        }
 
-constexpr int double_pawn_penalty = 20;
-// pawns get a bonus for defending another pawn
-constexpr int pawn_chain_defense_bonus = 10;
+        auto probes () const -> size_t {return num_probes;}
+        auto hits () const -> size_t {return num_hits;}
+        auto reset_stats () -> void {num_probes = 0; num_hits = 0;}
 
-constexpr int king_safety_lastrank_val = 40;
-constexpr int king_safety_2ndlastrank_val = 15;
+private:
+        struct Entry {
+                uint64_t key = 0;
+                PawnEval eval;
+        };
 
-// todo quiescence seacg?
-constexpr int attack_other_king_val = 40;
+        std::vector<Entry> entries;
+        size_t mask;
+
+        size_t num_probes = 0;
+        size_t num_hits = 0;
+};
+
+// direct mapped cache of whole static evals, keyed by the full hash
+// leaves are often reached through transpositions, and the depth 0 nodes in the transposition table
+// are the first to be replaced, so this keeps the evals around a bit longer
+// every search thread has its own, so no locking
+class EvalCache {
+public:
+        explicit EvalCache (size_t num_entries = 1 << 16)
+                : entries(std::bit_ceil(num_entries)),
+                  mask(entries.size() - 1)
+        { }
+
+        auto find (uint64_t hash) -> std::optional<Eval>
+        {
+                num_probes++;
+                const Entry &entry = entries[hash & mask];
+                // a hash of 0 marks an empty entry, like in the transposition table
+                if (entry.key == hash && hash != 0) {
+                        num_hits++;
+                        return entry.eval;
+                }
+                return std::nullopt;
+        }
 
+        auto store (uint64_t hash, Eval eval) -> void
+        {
+                entries[hash & mask] = Entry{hash, eval};
+        }
+
+        auto probes () const -> size_t {return num_probes;}
+        auto hits () const -> size_t {return num_hits;}
+        auto reset_stats () -> void {num_probes = 0; num_hits = 0;}
+        auto clear () -> void {std::ranges::fill(entries, Entry{});}
+
+private:
+        struct Entry {
+                uint64_t key = 0;
+                Eval eval = 0;
+        };
+
+        std::vector<Entry> entries;
+        size_t mask;
+
+        size_t num_probes = 0;
+        size_t num_hits = 0;
+};
 
 // heuristic evaluation method
+// only the terms that are not kept incrementally in board.piece_square_score
+// and not in the pawn structure
 template <Color col>  // col to move
 constexpr
-auto eval_col (const Position &board) -> Eval
+auto eval_col (const Position &board, const uint8_t open_files) -> Eval
 {
         constexpr bool is_white = col == Color::white;
 
@@ -109,8 +256,7 @@ auto eval_col (const Position &board) -> Eval
         const Field atm = board.attack_map<col>();
         const Field all_friendly = board.get_occupation<col>();
 
-        const Field &queens  = board.queen<col>(),
-                    &pawns   = board.pawns<col>(),
+        const Field &pawns   = board.pawns<col>(),
                     &rooks   = board.rooks<col>(),
                     &horses  = board.horses<col>(),
                     &bishops = board.bishops<col>(),
@@ -124,21 +270,12 @@ auto eval_col (const Position &board) -> Eval
                     &enemy_king    = board.king<!col>();
 
 
-        const uint8_t num_queens  = bit_count(queens),
-                      num_pawns   = bit_count(pawns),
-                      num_rooks   = bit_count(rooks),
-                      num_horses  = bit_count(horses),
+        const uint8_t num_horses  = bit_count(horses),
                       num_bishops = bit_count(bishops);
 
-        score  = queen_val  * num_queens;
-        score += rook_val   * num_rooks;
-        score += horse_val  * num_horses;
-        score += bishop_val * num_bishops;
-        score += pawn_val   * num_pawns;
-
         // bonus bishop pair if there are bishops on both colors
         if (bishops & msk::white_squares && bishops & msk::black_squares) {
-                score += 40;
+                score += bishop_pair_bonus;
         }
 
         // assign score to "activity" of board
@@ -151,57 +288,19 @@ auto eval_col (const Position &board) -> Eval
         score += horse_attack_val  * bit_count(atm & enemy_horses);
         score += pawn_attack_val   * bit_count(atm & enemy_pawns);
 
-        auto rel_rank = [](int r) -> Field {
-                return is_white ? msk::rank[r] : msk::rank[7 - r];
-        };
-
-        // central pawns are worth more
-        score += 15  * bit_count(pawns & ~msk::file[0] & ~msk::file[7]);
-
-        // and rook-file pawns less
-        score -= 10 * bit_count(pawns & msk::file[0] & msk::file[7]);
-
-        // pawn promotion
-        // score += 1. * bit_count(board.pawns<col>() & rel_rank(5));
-        // score += 2. * bit_count(board.pawns<col>() & rel_rank(6));
-
-        score += 100 * bit_count(pawns & rel_rank(5));
-        score += 150 * bit_count(pawns & rel_rank(6));
-
-        // horsies get penalty on the edges
-        score -= 40 * bit_count(horses & msk::ring[0]);
-        score -= 20 * bit_count(horses & msk::ring[1]);
-        score += 20 * bit_count(horses & msk::ring[3]);
-
         // horses get a bonus if there are more pawns
-        score += num_horses * 6 * bit_count(pawns | enemy_pawns);
+        score += num_horses * horse_pawn_bonus * bit_count(pawns | enemy_pawns);
 
         // bishops get a slight penalty for pawns
-        score -= num_bishops * 3 * bit_count(pawns | enemy_pawns);
+        score -= num_bishops * bishop_pawn_penalty * bit_count(pawns | enemy_pawns);
 
         // bonus for rooks that don't look at a friendly pawn ahead
-
-        int num_unblocked_rooks = 0;
-        int num_double_pawns = 0;
-        for (Field file = msk::file[0]; file; shift<east>(file)) {
-                if (file & rooks && (file & pawns) == 0ull) {
-                        num_unblocked_rooks++;
-                }
-                const int num_pawns = bit_count(pawns & file);
-                if (num_pawns > 1) {
-                        num_double_pawns += num_pawns - 1;
-                }
-        }
-
+        const int num_unblocked_rooks = bit_count(occupied_files(rooks) & open_files);
         score += unblocked_rook_score * num_unblocked_rooks;
-        score -= double_pawn_penalty * num_double_pawns;
 
         // pawns seeing bigger pieces is a nice bonus
         const Field pawns_east_attack = is_white ? shifted<northEast>(pawns) : shifted<southEast>(pawns);
-        const Field pawns_west_attack = is_white ? shifted<northWest>(pawns) : shifted<southWest>(pawns);;
-
-        score += pawn_chain_defense_bonus * bit_count(pawns_east_attack & pawns);
-        score += pawn_chain_defense_bonus * bit_count(pawns_west_attack & pawns);
+        const Field pawns_west_attack = is_white ? shifted<northWest>(pawns) : shifted<southWest>(pawns);
 
         score += pawn_delta_attack_val * ((rook_val - 100) / 100) * bit_count(pawns_east_attack & enemy_rooks);
         score += pawn_delta_attack_val * ((rook_val - 100) / 100) * bit_count(pawns_west_attack & enemy_rooks);
@@ -212,14 +311,8 @@ auto eval_col (const Position &board) -> Eval
         score += pawn_delta_attack_val * ((bishop_val - 100) / 100) * bit_count(pawns_east_attack & enemy_bishops);
         score += pawn_delta_attack_val * ((bishop_val - 100) / 100) * bit_count(pawns_west_attack & enemy_bishops);
 
-        // and king safety
-        score += king_safety_2ndlastrank_val * bit_count(king & (msk::rank[1] | msk::rank[6]));
-        score += king_safety_2ndlastrank_val * bit_count(king & (msk::file[1] | msk::file[6]));
-        score += king_safety_lastrank_val * bit_count(king & (msk::rank[0] | msk::rank[7]));
-        score += king_safety_lastrank_val * bit_count(king & (msk::file[0] | msk::file[7]));
-
         // penalty for open area around king
-        score -= 15 * bit_count(get_king_area(OneSquare_unsafe(king)) & ~all_friendly);
+        score -= king_open_area_penalty * bit_count(get_king_area(OneSquare_unsafe(king)) & ~all_friendly);
 
         if (atm & enemy_king)
                 score += attack_other_king_val;
@@ -227,10 +320,121 @@ auto eval_col (const Position &board) -> Eval
         return score;
 }
 
+inline
+auto static_eval(const Position &board, const PawnEval &pawn_eval) -> Eval
+{
+        assert(board.piece_square_is_consistent());
+        return truncated(tapered(board.piece_square_score, board.phase) + pawn_eval.score
+                         + eval_col<Color::white>(board, pawn_eval.white_open_files)
+                         - eval_col<Color::black>(board, pawn_eval.black_open_files));
+}
+
 inline
 auto static_eval(const Position &board) -> Eval
 {
-        return truncated(eval_col<Color::white>(board) - eval_col<Color::black>(board));
+        return static_eval(board, pawn_structure_eval(board));
+}
+
+// takes the pawn terms from the table
+inline
+auto static_eval(const PositionHashPair &pos_hash, PawnTable &pawn_table) -> Eval
+{
+        return static_eval(pos_hash.pos, pawn_table.probe(pos_hash));
+}
+
+// how far a sum of eval terms can be above and below 0
+struct EvalBounds {
+        Eval above = 0;
+        Eval below = 0;
+
+        // a term of coef times a count from 0 to max_count
+        // the coef may have either sign, so the bounds still hold after tuning
+        constexpr auto add (int coef, int max_count) -> void
+        {
+                above += std::max(coef, 0) * max_count;
+                below += std::max(-coef, 0) * max_count;
+        }
+};
+
+// how far eval_col<col> can be above and below 0, from the piece counts alone
+// every term is bounded by the most it could add or take with these pieces
+template <Color col>
+constexpr
+auto eval_col_bounds (const Position &board) -> EvalBounds
+{
+        const int num_pawns   = bit_count(board.pawns<col>()),
+                  num_rooks   = bit_count(board.rooks<col>()),
+                  num_horses  = bit_count(board.horses<col>()),
+                  num_bishops = bit_count(board.bishops<col>()),
+                  num_queens  = bit_count(board.queen<col>());
+
+        const int enemy_pawns   = bit_count(board.pawns<!col>()),
+                  enemy_rooks   = bit_count(board.rooks<!col>()),
+                  enemy_horses  = bit_count(board.horses<!col>()),
+                  enemy_bishops = bit_count(board.bishops<!col>()),
+                  enemy_queens  = bit_count(board.queen<!col>());
+
+        // the most squares these pieces and the king attack on an empty board
+        const int max_attacked = std::min(64, 2 * num_pawns + 8 * num_horses + 13 * num_bishops
+                                              + 14 * num_rooks + 27 * num_queens + 8);
+        const int all_pawns = num_pawns + enemy_pawns;
+
+        EvalBounds bounds;
+        bounds.add(bishop_pair_bonus, 1);
+        bounds.add(par_square_attack_score, max_attacked);
+        bounds.add(queen_attack_val, enemy_queens);
+        bounds.add(rook_attack_val, enemy_rooks);
+        bounds.add(bishop_attack_val, enemy_bishops);
+        bounds.add(horse_attack_val, enemy_horses);
+        bounds.add(pawn_attack_val, enemy_pawns);
+        bounds.add(horse_pawn_bonus, num_horses * all_pawns);
+        bounds.add(-bishop_pawn_penalty, num_bishops * all_pawns);
+        bounds.add(unblocked_rook_score, num_rooks);
+
+        // each enemy piece can be attacked by a pawn from both sides
+        bounds.add(pawn_delta_attack_val * ((rook_val - 100) / 100), 2 * enemy_rooks);
+        bounds.add(pawn_delta_attack_val * ((queen_val - 100) / 100), 2 * enemy_queens);
+        bounds.add(pawn_delta_attack_val * ((horse_val - 100) / 100), 2 * enemy_horses);
+        bounds.add(pawn_delta_attack_val * ((bishop_val - 100) / 100), 2 * enemy_bishops);
+
+        bounds.add(-king_open_area_penalty, 8);
+        bounds.add(attack_other_king_val, 1);
+
+        return bounds;
 }
 
+struct LazyEval {
+        Eval eval;
+        bool exact;     // if not, the eval is a lower bound above the window or an upper bound below it
+};
+
+// like static_eval, but if material, piece squares and pawns are so far outside [alpha, beta]
+// that the other terms can not bring it back, those are skipped
+inline
+auto lazy_static_eval(const PositionHashPair &pos_hash, PawnTable &pawn_table, Eval alpha, Eval beta) -> LazyEval
+{
+        const PawnEval pawn_eval = pawn_table.probe(pos_hash);
+        const Eval cheap = truncated(tapered(pos_hash.pos.piece_square_score, pos_hash.pos.phase) + pawn_eval.score);
+
+        // the real eval is the cheap eval with the eval_col terms, which are within these bounds
+        // in 64 bit, so this can not overflow near the mate evals
+        const EvalBounds white = eval_col_bounds<Color::white>(pos_hash.pos);
+        const EvalBounds black = eval_col_bounds<Color::black>(pos_hash.pos);
+        const int64_t lower = static_cast<int64_t>(cheap) - white.below - black.above;
+        const int64_t upper = static_cast<int64_t>(cheap) + white.above + black.below;
+        assert((lower <= beta && upper >= alpha) || (static_eval(pos_hash.pos, pawn_eval) >= lower
+                                                      && static_eval(pos_hash.pos, pawn_eval) <= upper));
+        if (lower > beta)
+                return {static_cast<Eval>(lower), false};
+        if (upper < alpha)
+                return {static_cast<Eval>(upper), false};
+
+        return {static_eval(pos_hash.pos, pawn_eval), true};
+}
+
+// static_eval of every position, evals[i] is the eval of positions[i]
+// the bitboards of a few positions at a time are put side by side in a vector register,
+// so the popcounts and products of the eval terms are done for all of them at once
+auto static_eval_batch (std::span<const Position> positions, std::span<Eval> evals) -> void;
+
 #endif //BOT_DEV_EVAL_H
@@ -32,10 +32,16 @@ inline
 auto make_move_unsafe(Move cpm, Position &board) -> void;
 
 // this overload
+// in debug builds it checks the incremental hashes against a full recomputation
 template <Color col>
 inline
 auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void;
 
+// the same without the check
+template <Color col>
+inline
+auto make_move_incremental(Move cpm, PositionHashPair &pos_hash) -> void;
+
 constexpr size_t maxMoves = 256;
 
 struct MoveList {
@@ -87,6 +93,19 @@ struct MoveList {
                   end_p(list.data())
         { }
 
+        // end_p points into the list, so it can not just be copied
+        MoveList (const MoveList &other)
+                : list(other.list),
+                  end_p(list.data() + other.size())
+        { }
+
+        auto operator= (const MoveList &other) -> MoveList &
+        {
+                list = other.list;
+                end_p = list.data() + other.size();
+                return *this;
+        }
+
         std::array<Move, maxMoves> list;
         Move *end_p;
 };
@@ -96,6 +115,13 @@ template <Color col>
 inline
 auto generate_moves (const Position &pos, MoveList &move_list) -> void;
 
+// generates all moves for color col when the king of col is in check
+// checkers has the squares of the piece(s) that give the check
+// with a double check only king moves are generated
+template <Color col>
+inline
+auto generate_evasions (const Position &pos, Field checkers, MoveList &move_list) -> void;
+
 //////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////
 /// TEMPLATE DEFINITIONS
@@ -125,14 +151,22 @@ template <Color col>
 inline
 auto make_move_unsafe(Move cpm, Position &board) -> void
 {
+        assert(board.occupation_is_consistent());
+        assert(board.mailbox_is_consistent());
+
+        constexpr Epiece colking = white_black<col>(white_king, black_king);
+        constexpr Epiece colqueen = white_black<col>(white_queen, black_queen);
+        constexpr Epiece colrook = white_black<col>(white_rooks, black_rooks);
+        constexpr Epiece colhorse = white_black<col>(white_horses, black_horses);
+        constexpr Epiece colbishop = white_black<col>(white_bishops, black_bishops);
+        constexpr Epiece colpawn = white_black<col>(white_pawns, black_pawns);
+
+        constexpr Epiece othercolpawn = white_black<col>(black_pawns, white_pawns);
+
         const OneSquare from = cpm.from_square();
         const OneSquare to   = cpm.to_square();
         const uint8_t from_file = cpm.from_file();
-        const uint8_t from_rank = cpm.from_rank();
         const uint8_t to_file = cpm.to_file();
-        const uint8_t to_rank = cpm.to_rank();
-
-        const Field from_and_to = from | to;
 
         // const Field all_this   = board.get_occupation<col>();
         const Field all_other = board.get_occupation<!col>();
@@ -148,9 +182,9 @@ auto make_move_unsafe(Move cpm, Position &board) -> void
 
 
         // a normal move consists of the following:
+        // - any piece on the to square is captured
         // - original piece is removed
         // - this piece is then placed at the to file
-        // - any piece there is captured
 
         // castling and en passant is taken care of in a special case
 
@@ -161,14 +195,12 @@ auto make_move_unsafe(Move cpm, Position &board) -> void
         case Move::castle:
                 // there can never be any capture with castling (we don't check)
                 if (cpm.get_castle_type() == Move::CastleType::queenside) {
-                        constexpr Field rook_from = white_black<col>(white_queen_rook, black_queen_rook);
-                        constexpr Field rook_to   = white_black<col>(white_queen_rook_to, black_queen_rook_to);
-                        constexpr Field rook_from_and_to = rook_from | rook_to;
-                        constexpr Field king_from = white_black<col>(white_king_start, black_king_start);
-                        constexpr Field king_to   = white_black<col>(white_king_queenside_to, black_king_queenside_to);
-                        board.rooks<col>() ^= rook_from_and_to; // move rook
-                        board.king<col>()  ^= king_from;
-                        board.king<col>()  ^= king_to;
+                        constexpr OneSquare rook_from = OneSquare_unsafe(white_black<col>(white_queen_rook, black_queen_rook));
+                        constexpr OneSquare rook_to   = OneSquare_unsafe(white_black<col>(white_queen_rook_to, black_queen_rook_to));
+                        constexpr OneSquare king_from = OneSquare_unsafe(white_black<col>(white_king_start, black_king_start));
+                        constexpr OneSquare king_to   = OneSquare_unsafe(white_black<col>(white_king_queenside_to, black_king_queenside_to));
+                        board.move_piece(colrook, rook_from, rook_to); // move rook
+                        board.move_piece(colking, king_from, king_to);
 
                         meta.set_pawn_2fwd(8);
                         meta.disallow_queen_castle<col>();
@@ -176,14 +208,12 @@ auto make_move_unsafe(Move cpm, Position &board) -> void
                         meta.inc_passive_move_counter();
                 } else {
                         // kingside
-                        constexpr Field rook_from = white_black<col>(white_king_rook, black_king_rook);
-                        constexpr Field rook_to   = white_black<col>(white_king_rook_to, black_king_rook_to);
-                        constexpr Field rook_from_and_to = rook_from | rook_to;
-                        constexpr Field king_from = white_black<col>(white_king_start, black_king_start);
-                        constexpr Field king_to   = white_black<col>(white_king_kingside_to, black_king_kingside_to);
-                        board.rooks<col>() ^= rook_from_and_to;
-                        board.king<col>()  ^= king_from;
-                        board.king<col>()  ^= king_to;
+                        constexpr OneSquare rook_from = OneSquare_unsafe(white_black<col>(white_king_rook, black_king_rook));
+                        constexpr OneSquare rook_to   = OneSquare_unsafe(white_black<col>(white_king_rook_to, black_king_rook_to));
+                        constexpr OneSquare king_from = OneSquare_unsafe(white_black<col>(white_king_start, black_king_start));
+                        constexpr OneSquare king_to   = OneSquare_unsafe(white_black<col>(white_king_kingside_to, black_king_kingside_to));
+                        board.move_piece(colrook, rook_from, rook_to);
+                        board.move_piece(colking, king_from, king_to);
 
                         meta.set_pawn_2fwd(8);
                         meta.disallow_king_castle<col>();
@@ -194,8 +224,8 @@ auto make_move_unsafe(Move cpm, Position &board) -> void
         case Move::en_passant:
                 {
                         constexpr Direction one_back  = white_black<col>(south, north);
-                        board.pawns<col>() ^= from_and_to;      // move pawn
-                        board.pawns<!col>() ^= shifted<one_back>(to); // capture the en-passanted pawn
+                        board.remove_piece(othercolpawn, OneSquare_unsafe(shifted<one_back>(to))); // capture the en-passanted pawn
+                        board.move_piece(colpawn, from, to);      // move pawn
 
                         meta.reset_passive_move_counter();
                         meta.set_pawn_2fwd(8);
@@ -205,23 +235,24 @@ auto make_move_unsafe(Move cpm, Position &board) -> void
                 // a pawn move with promotion
                 // there could be a capture
                 {
-                        board.pawns<col>() ^= from;
+                        if (from_file != to_file)
+                                board.set_all_0<!col>(to);
+
+                        board.remove_piece(colpawn, from);
                         switch (cpm.get_promotion()) {
                         case Move::queen_promo:
-                                board.queen<col>() ^= to;
+                                board.place_piece(colqueen, to);
                                 break;
                         case Move::rook_promo:
-                                board.rooks<col>() ^= to;
+                                board.place_piece(colrook, to);
                                 break;
                         case Move::bishop_promo:
-                                board.bishops<col>() ^= to;
+                                board.place_piece(colbishop, to);
                                 break;
                         case Move::horse_promo:
-                                board.horses<col>() ^= to;
+                                board.place_piece(colhorse, to);
                                 break;
                         }
-                        if (from_file != to_file)
-                                board.set_all_0<!col>(to);
 
                         meta.reset_passive_move_counter();
                         meta.set_pawn_2fwd(8);
@@ -246,12 +277,12 @@ auto make_move_unsafe(Move cpm, Position &board) -> void
 
                         if (shifted<one_ahead>(from) == to) {
                                 // one tile
-                                board.pawns<col>() ^= from_and_to;
+                                board.move_piece(colpawn, from, to);
                                 meta.set_pawn_2fwd(8);
                                 return;
                         } else {
                                 // two tiles
-                                board.pawns<col>() ^= from_and_to;
+                                board.move_piece(colpawn, from, to);
                                 meta.set_pawn_2fwd(square_file(from));
                                 return;
                         }
@@ -260,8 +291,8 @@ auto make_move_unsafe(Move cpm, Position &board) -> void
                         // diagonal
                         // normal capture
 
-                        board.pawns<col>() ^= from_and_to;
                         board.set_all_0<!col>(to); // capture
+                        board.move_piece(colpawn, from, to);
                         meta.set_pawn_2fwd(8);
                         return;
                         // en passant and promotion has been taken care of
@@ -271,14 +302,20 @@ auto make_move_unsafe(Move cpm, Position &board) -> void
         // any normal move with a piece (not pawn)
         // no castling
 
+        // capture with any piece
+        if (to & all_other) {
+                board.set_all_0<!col>(to);
+                meta.reset_passive_move_counter();
+        } else {
+                meta.inc_passive_move_counter();
+        }
+
         if (from & board.horses<col>()) {
-                // board.horses<col>() ^= from;
-                // board.horses<col>() ^= to;
-                board.horses<col>() ^= from_and_to;
+                board.move_piece(colhorse, from, to);
         } else if (from & board.bishops<col>()) {
-                board.bishops<col>() ^= from_and_to;
+                board.move_piece(colbishop, from, to);
         } else if (from & board.rooks<col>()) {
-                board.rooks<col>() ^= from_and_to;
+                board.move_piece(colrook, from, to);
 
                 constexpr Field queenside_rook = white_black<col>(white_queen_rook, black_queen_rook);
                 constexpr Field kingside_rook = white_black<col>(white_king_rook, black_king_rook);
@@ -290,19 +327,11 @@ auto make_move_unsafe(Move cpm, Position &board) -> void
                 }
 
         } else if (from & board.king<col>()) {
-                board.king<col>() ^= from_and_to;
+                board.move_piece(colking, from, to);
                 meta.disallow_queen_castle<col>();
                 meta.disallow_king_castle<col>();
         } else /* no alternative but queen */ {
-                board.queen<col>() ^= from_and_to;
-        }
-
-        // capture with any piece
-        if (to & all_other) {
-                board.set_all_0<!col>(to);
-                meta.reset_passive_move_counter();
-        } else {
-                meta.inc_passive_move_counter();
+                board.move_piece(colqueen, from, to);
         }
 
         meta.set_pawn_2fwd(8);
@@ -311,11 +340,26 @@ auto make_move_unsafe(Move cpm, Position &board) -> void
 template <Color col>
 inline
 auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
+{
+        make_move_incremental<col>(cpm, pos_hash);
+
+        // a wrong hash is never noticed otherwise, the search just gets bad transposition table hits
+        assert(pos_hash.hash == zobrist_hash(pos_hash.pos));
+        assert(pos_hash.pawn_hash == pawn_zobrist_hash(pos_hash.pos));
+}
+
+template <Color col>
+inline
+auto make_move_incremental(Move cpm, PositionHashPair &pos_hash) -> void
 {
         using namespace HashConstants;
 
         Position &board = pos_hash.pos;
         uint64_t &hash  = pos_hash.hash;
+        uint64_t &pawn_hash = pos_hash.pawn_hash;
+
+        assert(board.occupation_is_consistent());
+        assert(board.mailbox_is_consistent());
 
         constexpr Epiece colking = white_black<col>(white_king, black_king);
         constexpr Epiece colqueen = white_black<col>(white_queen, black_queen);
@@ -330,31 +374,15 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
         const OneSquare from = cpm.from_square();
         const OneSquare to   = cpm.to_square();
         const uint8_t from_file = cpm.from_file();
-        const uint8_t from_rank = cpm.from_rank();
         const uint8_t to_file = cpm.to_file();
-        const uint8_t to_rank = cpm.to_rank();
-
-        const Field from_and_to = from | to;
 
         // const Field all_this   = board.get_occupation<col>();
         // const Field all_other = board.get_occupation<!col>();
         // const Field all       = all_col | all_other;
 
-        auto check_for_capture = [&](Field f) -> std::optional<Epiece> {
-                if (board.pawns<!col>() & f)
-                        return white_black<col>(black_pawns, white_pawns);
-                if (board.rooks<!col>() & f)
-                        return white_black<col>(black_rooks, white_rooks);
-                if (board.bishops<!col>() & f)
-                        return white_black<col>(black_bishops, white_bishops);
-                if (board.horses<!col>() & f)
-                        return white_black<col>(black_horses, white_horses);
-                if (board.queen<!col>() & f)
-                        return white_black<col>(black_queen, white_queen);
-                // king is not captured anyway
-                // todo
-                return std::nullopt;
-        };
+        // the mailbox tells us what is captured, if anything
+        // the king is never captured anyway
+        const Epiece captured = board.piece_on(to);
 
         // metadata:
         // * in all control paths we must set the active_color color to the other one
@@ -365,9 +393,9 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
 
 
         // a normal move consists of the following:
+        // - any piece on the to square is captured
         // - original piece is removed
         // - this piece is then placed at the to file
-        // - any piece there is captured
 
         // castling and en passant is taken care of in a special case
 
@@ -384,16 +412,14 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
         case Move::castle:
                 // there can never be any capture with castling (we don't check)
                 if (cpm.get_castle_type() == Move::CastleType::queenside) {
-                        constexpr Field rook_from = white_black<col>(white_queen_rook, black_queen_rook);
-                        constexpr Field rook_to   = white_black<col>(white_queen_rook_to, black_queen_rook_to);
-                        constexpr Field rook_from_and_to = rook_from | rook_to;
-                        constexpr Field king_from = white_black<col>(white_king_start, black_king_start);
-                        constexpr Field king_to   = white_black<col>(white_king_queenside_to, black_king_queenside_to);
+                        constexpr OneSquare rook_from = OneSquare_unsafe(white_black<col>(white_queen_rook, black_queen_rook));
+                        constexpr OneSquare rook_to   = OneSquare_unsafe(white_black<col>(white_queen_rook_to, black_queen_rook_to));
+                        constexpr OneSquare king_from = OneSquare_unsafe(white_black<col>(white_king_start, black_king_start));
+                        constexpr OneSquare king_to   = OneSquare_unsafe(white_black<col>(white_king_queenside_to, black_king_queenside_to));
 
                         // move pieces
-                        board.rooks<col>() ^= rook_from_and_to;
-                        board.king<col>()  ^= king_from;
-                        board.king<col>()  ^= king_to;
+                        board.move_piece(colrook, rook_from, rook_to);
+                        board.move_piece(colking, king_from, king_to);
 
                         // get some hash constants
                         constexpr int rook_from_shift = trailing_0_count(rook_from);
@@ -411,14 +437,12 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
 
                 } else {
                         // kingside
-                        constexpr Field rook_from = white_black<col>(white_king_rook, black_king_rook);
-                        constexpr Field rook_to   = white_black<col>(white_king_rook_to, black_king_rook_to);
-                        constexpr Field rook_from_and_to = rook_from | rook_to;
-                        constexpr Field king_from = white_black<col>(white_king_start, black_king_start);
-                        constexpr Field king_to   = white_black<col>(white_king_kingside_to, black_king_kingside_to);
-                        board.rooks<col>() ^= rook_from_and_to;
-                        board.king<col>()  ^= king_from;
-                        board.king<col>()  ^= king_to;
+                        constexpr OneSquare rook_from = OneSquare_unsafe(white_black<col>(white_king_rook, black_king_rook));
+                        constexpr OneSquare rook_to   = OneSquare_unsafe(white_black<col>(white_king_rook_to, black_king_rook_to));
+                        constexpr OneSquare king_from = OneSquare_unsafe(white_black<col>(white_king_start, black_king_start));
+                        constexpr OneSquare king_to   = OneSquare_unsafe(white_black<col>(white_king_kingside_to, black_king_kingside_to));
+                        board.move_piece(colrook, rook_from, rook_to);
+                        board.move_piece(colking, king_from, king_to);
 
                         // get some hash constants
                         // square_to_shift === trailing_0_count
@@ -455,9 +479,9 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
         case Move::en_passant:
                 {
                         constexpr Direction one_back = white_black<col>(south, north);
-                        const Field enemy_pawn_sq = shifted<one_back>(to);
-                        board.pawns<col>() ^= from_and_to;      // move pawn
-                        board.pawns<!col>() ^= enemy_pawn_sq; // capture the en-passanted pawn
+                        const OneSquare enemy_pawn_sq = OneSquare_unsafe(shifted<one_back>(to));
+                        board.remove_piece(othercolpawn, enemy_pawn_sq); // capture the en-passanted pawn
+                        board.move_piece(colpawn, from, to);      // move pawn
 
                         // move hash
 
@@ -465,7 +489,11 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
                         hash ^= piece_square_hash(colpawn, square_to_shift(to));
 
                         // capture hash
-                        hash ^= piece_square_hash(othercolpawn, trailing_0_count(enemy_pawn_sq));
+                        hash ^= piece_square_hash(othercolpawn, square_to_shift(enemy_pawn_sq));
+
+                        pawn_hash ^= piece_square_hash(colpawn, square_to_shift(from))
+                                   ^ piece_square_hash(colpawn, square_to_shift(to))
+                                   ^ piece_square_hash(othercolpawn, square_to_shift(enemy_pawn_sq));
 
                         meta.reset_passive_move_counter();
 
@@ -478,37 +506,35 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
                 // a pawn move with promotion
                 // there could be a capture
                 {
+                        // maybe capture
+                        if (captured != no_piece) {
+                                board.remove_piece(captured, to); // capture
+                                hash ^= piece_square_hash(captured, square_to_shift(to));
+                        }
 
-                        board.pawns<col>() ^= from;
+                        // there are never pawns to capture on the last rank
+                        board.remove_piece(colpawn, from);
                         hash ^= piece_square_hash(colpawn, square_to_shift(from));
+                        pawn_hash ^= piece_square_hash(colpawn, square_to_shift(from));
 
                         switch (cpm.get_promotion()) {
                         case Move::queen_promo:
-                                board.queen<col>() ^= to;
+                                board.place_piece(colqueen, to);
                                 hash ^= piece_square_hash(colqueen, square_to_shift(to));
                                 break;
                         case Move::rook_promo:
-                                board.rooks<col>() ^= to;
+                                board.place_piece(colrook, to);
                                 hash ^= piece_square_hash(colrook, square_to_shift(to));
                                 break;
                         case Move::bishop_promo:
-                                board.bishops<col>() ^= to;
+                                board.place_piece(colbishop, to);
                                 hash ^= piece_square_hash(colbishop, square_to_shift(to));
                                 break;
                         case Move::horse_promo:
-                                board.horses<col>() ^= to;
+                                board.place_piece(colhorse, to);
                                 hash ^= piece_square_hash(colhorse, square_to_shift(to));
                                 break;
                         }
-                        // maybe capture
-                        // if (from_file != to_file)
-                        //        board.set_all_0<!col>(to);
-
-                        std::optional<Epiece> pc = check_for_capture(to);
-                        if (pc) {
-                                board.piece_field(*pc) ^= to; // capture
-                                hash ^= piece_square_hash(*pc, square_to_shift(to));
-                        }
 
                         meta.reset_passive_move_counter();
 
@@ -521,7 +547,7 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
                 break;
         }
 
-        if (board.pawns<col>() & from) {
+        if (board.piece_on(from) == colpawn) {
                 // en passant and promotion have been handled already
 
                 // in any case
@@ -535,18 +561,22 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
 
                         if (shifted<one_ahead>(from) == to) {
                                 // one tile
-                                board.pawns<col>() ^= from_and_to;
+                                board.move_piece(colpawn, from, to);
                                 hash ^= piece_square_hash(colpawn, square_to_shift(from));
                                 hash ^= piece_square_hash(colpawn, square_to_shift(to));
+                                pawn_hash ^= piece_square_hash(colpawn, square_to_shift(from))
+                                           ^ piece_square_hash(colpawn, square_to_shift(to));
 
                                 hash ^= en_passant_hash(meta.pawn2fwd_file());
                                 meta.set_pawn_2fwd(8);
                                 return;
                         } else {
                                 // two tiles
-                                board.pawns<col>() ^= from_and_to;
+                                board.move_piece(colpawn, from, to);
                                 hash ^= piece_square_hash(colpawn, square_to_shift(from));
                                 hash ^= piece_square_hash(colpawn, square_to_shift(to));
+                                pawn_hash ^= piece_square_hash(colpawn, square_to_shift(from))
+                                           ^ piece_square_hash(colpawn, square_to_shift(to));
 
                                 hash ^= en_passant_hash(meta.pawn2fwd_file());
                                 meta.set_pawn_2fwd(square_file(from));
@@ -558,15 +588,17 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
                         // diagonal
                         // normal capture
 
-                        // is always a capture, so can just * it todo
-                        Epiece pc = *check_for_capture(to); // more expensive check than the files
+                        // is always a capture
+                        board.remove_piece(captured, to);
+                        hash ^= piece_square_hash(captured, square_to_shift(to));
+                        if (captured == othercolpawn)
+                                pawn_hash ^= piece_square_hash(captured, square_to_shift(to));
 
-                        board.pawns<col>() ^= from_and_to;
+                        board.move_piece(colpawn, from, to);
                         hash ^= piece_square_hash(colpawn, square_to_shift(from));
                         hash ^= piece_square_hash(colpawn, square_to_shift(to));
-
-                        board.piece_field(pc) ^= to;
-                        hash ^= piece_square_hash(pc, square_to_shift(to));
+                        pawn_hash ^= piece_square_hash(colpawn, square_to_shift(from))
+                                   ^ piece_square_hash(colpawn, square_to_shift(to));
 
                         hash ^= en_passant_hash(meta.pawn2fwd_file());
                         meta.set_pawn_2fwd(8);
@@ -578,18 +610,30 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
         // any normal move with a piece (not pawn)
         // no castling
 
-        if (from & board.horses<col>()) {
-                // board.horses<col>() ^= from;
-                // board.horses<col>() ^= to;
-                board.horses<col>() ^= from_and_to;
+        // capture
+        if (captured != no_piece) {
+                // no en passant, so always capture on the square we go to
+                board.remove_piece(captured, to);
+                hash ^= piece_square_hash(captured, square_to_shift(to));
+                if (captured == othercolpawn)
+                        pawn_hash ^= piece_square_hash(captured, square_to_shift(to));
+
+                meta.reset_passive_move_counter();
+        } else {
+                meta.inc_passive_move_counter();
+        }
+
+        const Epiece moved = board.piece_on(from);
+        if (moved == colhorse) {
+                board.move_piece(colhorse, from, to);
                 hash ^= piece_square_hash(colhorse, square_to_shift(from));
                 hash ^= piece_square_hash(colhorse, square_to_shift(to));
-        } else if (from & board.bishops<col>()) {
-                board.bishops<col>() ^= from_and_to;
+        } else if (moved == colbishop) {
+                board.move_piece(colbishop, from, to);
                 hash ^= piece_square_hash(colbishop, square_to_shift(from));
                 hash ^= piece_square_hash(colbishop, square_to_shift(to));
-        } else if (from & board.rooks<col>()) {
-                board.rooks<col>() ^= from_and_to;
+        } else if (moved == colrook) {
+                board.move_piece(colrook, from, to);
                 hash ^= piece_square_hash(colrook, square_to_shift(from));
                 hash ^= piece_square_hash(colrook, square_to_shift(to));
 
@@ -607,8 +651,8 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
                         hash ^= castling_right_hash(meta.castle_rights);
                 }
 
-        } else if (from & board.king<col>()) {
-                board.king<col>() ^= from_and_to;
+        } else if (moved == colking) {
+                board.move_piece(colking, from, to);
                 hash ^= piece_square_hash(colking, square_to_shift(from));
                 hash ^= piece_square_hash(colking, square_to_shift(to));
 
@@ -620,23 +664,11 @@ auto make_move_unsafe(Move cpm, PositionHashPair &pos_hash) -> void
                         hash ^= castling_right_hash(meta.castle_rights);
                 }
         } else /* no alternative but queen */ {
-                board.queen<col>() ^= from_and_to;
+                board.move_piece(colqueen, from, to);
                 hash ^= piece_square_hash(colqueen, square_to_shift(from));
                 hash ^= piece_square_hash(colqueen, square_to_shift(to));
         }
 
-        // capture
-        std::optional<Epiece> captured = check_for_capture(to);
-        if (captured) {
-                // no en passant, so always capture on the square we go to
-                board.piece_field(*captured) ^= to;
-                hash ^= piece_square_hash(*captured, square_to_shift(to));
-
-                meta.reset_passive_move_counter();
-        } else {
-                meta.inc_passive_move_counter();
-        }
-
         hash ^= en_passant_hash(meta.pawn2fwd_file());
         meta.set_pawn_2fwd(8);
 }
@@ -651,7 +683,7 @@ auto generate_moves (const Position &pos, MoveList &move_list) -> void
         constexpr Color other_col = !col;
         const Field all_friendly = pos.get_occupation<col>();
         const Field all_hostile = pos.get_occupation<other_col>();
-        const Field total = all_friendly | all_hostile;        // has all non-empty squares
+        const Field total = pos.get_total_occupation();        // has all non-empty squares
 
         // reference to primitive board
         const PiecewiseBoard &pos_board = pos;
@@ -1001,7 +1033,7 @@ auto generate_moves2 (const Position &pos, MoveList &move_list) -> void
         constexpr Color other_col = !col;
         const Field all_friendly = pos.get_occupation<col>();
         const Field all_hostile  = pos.get_occupation<other_col>();
-        const Field total = all_friendly | all_hostile;        // has all non-empty squares
+        const Field total = pos.get_total_occupation();        // has all non-empty squares
 
         // todo this is ugly as hell
 
@@ -1494,59 +1526,19 @@ auto generate_moves2 (const Position &pos, MoveList &move_list) -> void
 }
 */
 
-template <Color col>
-inline
-// auto generate_moves_sorted (const Position &pos, MoveList &move_list) -> void
-auto generate_moves (const Position &pos, MoveList &move_list) -> void
-{
-        // not micro optimized
-
-        // move sorting is important for the algorithm, so we sort
-        // different kinds of moves into different lists
-        // we merge them all before returning
-        MoveList captures;
-        MoveList blocks;
-        MoveList quiets;
-
-        // pushes the move onto the movelist, in an optimal order
-        auto push_list = [&]() -> void {
-                for (const Move capture : captures)
-                        move_list.emplace_back(capture);
-                for (const Move block : blocks)
-                        move_list.emplace_back(block);
-                for (const Move quiet : quiets)
-                        move_list.emplace_back(quiet);
-        };
-
-        constexpr bool is_white = col == Color::white;
-        constexpr Color other_col = !col;
-        const Field all_friendly = pos.get_occupation<col>();
-        const Field all_hostile  = pos.get_occupation<other_col>();
-        const Field total = all_friendly | all_hostile;        // has all non-empty squares
-
-        // todo this is ugly as hell
-
-        // const Field king_ = pos.king<col>();
-        // const OneSquare &king = *reinterpret_cast<const OneSquare *>(&king_);
-        const OneSquare king = OneSquare_unsafe(pos.king<col>());
-        // const Field atm = pos.attack_map<other_col>();
-
-        constexpr Field en_passant_rank  = msk::rank[is_white ? 4 : 3];
-        constexpr Field back_rank        = msk::rank[is_white ? 7 : 0];
-        constexpr Field second_back_rank = msk::rank[is_white ? 6 : 1];
-        constexpr Field second_rank      = msk::rank[is_white ? 1 : 6];
-        constexpr Direction ahead = is_white ? north : south;
-
-        // the pinned array contains for each direction,
-        // the squares between the king and an active attacker, if any
-        // or 0 if there is no attacker from that direction
-        // if we capture the attacking piece, we're good too
-
+// the pins on the king of some color
+// pinned contains for each direction, the squares between the king and an active attacker, if any
+// or 0 if there is no attacker from that direction
+// if we capture the attacking piece, we're good too
+struct PinInfo {
         std::array<Field, 8> pinned = {};
 
         // the pieces that are causing the associated pins
         std::array<Field, 8> pin_causers = {};
 
+        // all pinned areas together, so that most pieces are done with one check
+        Field all_pinned = 0ull;
+
         // there is a very special case where there are two pawns next to each other
         // with a king and enemy rook on each side
         // one pawn captures the other en passant, and the rook sees the king
@@ -1554,16 +1546,51 @@ auto generate_moves (const Position &pos, MoveList &move_list) -> void
         // there can only be one allowed en passant anyway
         bool en_passant_pinned = false;
 
+        // returns true if this move is ILLEGAL due to a pin
+        // does not take into account the special en passant case
+        // it does take into account the normal en passant case
+        constexpr
+        auto prevents (const OneSquare &from, const OneSquare &to) const -> bool
+        {
+                if ((from & all_pinned) == 0ull)
+                        return false;
+
+                // if "from" is pinned, it can only move within the ray
+                for (const Direction dir : directions) {
+                        if (from & pinned[dir]) {
+                                // if "to" is within the ray, we return false, since we can move within the pinned area
+                                // if we capture the pinner, this is fine too
+                                return (to & (pinned[dir] | pin_causers[dir])) == 0ull;
+                        }
+                }
+                return false;
+        }
+};
+
+// finds all pins on the king of color col
+template <Color col>
+inline
+auto calculate_pins (const Position &pos) -> PinInfo
+{
+        constexpr bool is_white = col == Color::white;
+        constexpr Color other_col = !col;
+        const Field all_friendly = pos.get_occupation<col>();
+        const Field all_hostile  = pos.get_occupation<other_col>();
+        const OneSquare king = OneSquare_unsafe(pos.king<col>());
+
+        constexpr Field en_passant_rank = msk::rank[is_white ? 4 : 3];
+
         // is 0 if there is none
         const Field two_moved_pawn = msk::file[pos.meta.pawn2fwd_file()] & en_passant_rank;
 
         // contains the squares that can capture a pawn en passant, if any
         const Field en_passant_squares = shifted<east>(two_moved_pawn) | shifted<west>(two_moved_pawn);
 
-        // we find the pins first
         const Field straight_attackers = pos.rooks<other_col>() | pos.queen<other_col>();
         const Field diagonal_attackers = pos.bishops<other_col>() | pos.queen<other_col>();
 
+        PinInfo pins;
+
         auto calculate_pin = [&]<Direction dir> () {
                 const Field &danger = is_straight(dir) ? straight_attackers : diagonal_attackers;
                 const Field ray = get_weakly_blocked_ray<dir>(king, danger);
@@ -1577,11 +1604,12 @@ auto generate_moves (const Position &pos, MoveList &move_list) -> void
                         const int num_friendly_between = bit_count(all_friendly & in_between);
                         const int num_enemy_between = bit_count(all_hostile & in_between);
                         if (num_friendly_between == 1 && num_enemy_between == 0) {
-                                pinned[dir] = in_between;
-                                pin_causers[dir] = ray & danger;
+                                pins.pinned[dir] = in_between;
+                                pins.pin_causers[dir] = ray & danger;
+                                pins.all_pinned |= in_between;
                         } else if (is_diagonal(dir) && num_friendly_between == 0 && num_enemy_between == 1 && (in_between & two_moved_pawn)) {
                                 // we can not capture en passant, because that would expose the king
-                                en_passant_pinned = true;
+                                pins.en_passant_pinned = true;
                         } else if constexpr (dir == east || dir == west) {
 
                                 const bool is_special_case = num_friendly_between == 1
@@ -1591,32 +1619,13 @@ auto generate_moves (const Position &pos, MoveList &move_list) -> void
                                             ; // redundant && king & en_passant_rank; // and the king has to be there as well
 
                                 if (is_special_case) {
-                                        en_passant_pinned = true;
+                                        pins.en_passant_pinned = true;
                                 }
                         }
 
                 }
         };
 
-        // returns true if this move is ILLEGAL due to a pin
-        // does not take into account the special en passant case
-        // it does take into account the normal en passant case
-        auto pin_prevents = [&](const OneSquare &from, const OneSquare &to) -> bool {
-                // if "from" is pinned, it can only move within the ray
-                for (const Direction dir : directions) {
-                        const Field &pinned_areas = pinned[dir];
-                        const Field &pin_causer = pin_causers[dir];
-
-                        if (from & pinned_areas) {
-                                // if "to" is within the ray, we return false, since we can move within the pinned area
-                                // if we capture the pinner, this is fine too
-
-                                return (to & (pinned_areas | pin_causer)) == 0ull;
-                        }
-                }
-                return false;
-        };
-
         // thanks, Bjarne!
         calculate_pin.template operator()<north>();
         calculate_pin.template operator()<northEast>();
@@ -1627,250 +1636,224 @@ auto generate_moves (const Position &pos, MoveList &move_list) -> void
         calculate_pin.template operator()<west>();
         calculate_pin.template operator()<east>();
 
-        const Field active_horse_attackers = pos.horses<other_col>() & get_horse_jumps(king);
-        const Field active_diagonal_attackers = diagonal_attackers & get_weakly_blocked_diagonals(king, total);
-        const Field active_straight_attackers = straight_attackers & get_weakly_blocked_straights(king, total);
-        const Field active_pawn_attackers = [&]() -> Field {
-                if constexpr (is_white)
-                        return pos.pawns<other_col>() & (shifted<northEast>(king) | shifted<northWest>(king));
-                return pos.pawns<other_col>() & (shifted<southEast>(king) | shifted<southWest>(king));
-        }();
-
-        const Field all_active_attackers = active_horse_attackers | active_diagonal_attackers | active_straight_attackers | active_pawn_attackers;
-
-        // king is in check
-        // we must do something about it
-        if (all_active_attackers) {
-
-                // depending on what attacks us, we generate moves
-                // if there is only one attacker, capturing with an unpinned piece is an option
-                // as well as blocking
-
-                // evasion is always an option, also with multiple attackers
-                const int num_attackers = bit_count(all_active_attackers);
+        return pins;
+}
 
-                // if only one piece attacks the king, capturing or blocking is an option,
-                // provided we respect pins
-                // otherwise, we only have evasions
+template <Color col>
+inline
+auto generate_evasions (const Position &pos, const Field checkers, MoveList &move_list) -> void
+{
+        // the moves are written straight into the move list, in the order
+        // captures of the checker, king captures, blocks, other king moves
 
-                if (num_attackers == 1) {
-                        const Field active_attacker_ = [&]() -> Field {
-                                if (active_diagonal_attackers)
-                                        return active_diagonal_attackers;
-                                if (active_straight_attackers)
-                                        return active_straight_attackers;
-                                if (active_horse_attackers)
-                                        return active_horse_attackers;
-                                return active_pawn_attackers;
-                        }();
+        constexpr bool is_white = col == Color::white;
+        constexpr Color other_col = !col;
+        const Field all_friendly = pos.get_occupation<col>();
+        const Field all_hostile  = pos.get_occupation<other_col>();
+        const Field total = pos.get_total_occupation();
+        const OneSquare king = OneSquare_unsafe(pos.king<col>());
 
-                        // ugly as hell, yes. Too bad!
-                        // const OneSquare &active_attacker = *reinterpret_cast<const OneSquare *>(&active_attacker_);
-                        const OneSquare active_attacker = OneSquare_unsafe(active_attacker_);
+        constexpr Field en_passant_rank  = msk::rank[is_white ? 4 : 3];
+        constexpr Field back_rank        = msk::rank[is_white ? 7 : 0];
+        constexpr Field third_rank       = msk::rank[is_white ? 2 : 5];
+        constexpr Direction ahead  = is_white ? north : south;
+        constexpr Direction behind = is_white ? south : north;
+
+        // stepping aside is always an option, also with multiple attackers
+        // of course the king cannot stop the attack ray, since he has to step aside
+        // so we look at the attacked squares as if the king is not there
+        Position pos_without_king = pos;
+        pos_without_king.remove_piece(white_black<col>(white_king, black_king), king);
+        const Field defend_map = pos_without_king.defend_map<other_col>();
+        const Field king_available = get_king_area(king) & ~all_friendly & ~defend_map;
+
+        auto push_king_moves = [&](const Field to_squares) -> void {
+                for (Field f = to_squares; f; f &= f - 1)
+                        move_list.emplace_back(king, lowest_square(f));
+        };
 
-                        // find pieces of ours that can capture the attacker
-                        // no pinned pieces of course
+        // with two attackers, capturing or blocking one of them never helps
+        if (bit_count(checkers) > 1) {
+                push_king_moves(king_available & all_hostile);
+                push_king_moves(king_available & ~all_hostile);
+                return;
+        }
 
-                        // squares where we can place a piece of ours to block
-                        Field block_area     = 0ull;
+        // there is only one attacker
+        // capturing it or blocking it with an unpinned piece is an option
+        const OneSquare checker = OneSquare_unsafe(checkers);
+        const PinInfo pins = calculate_pins<col>(pos);
+
+        auto push_pawn_move = [&](const OneSquare from, const OneSquare to) -> void {
+                if (to & back_rank) {
+                        move_list.emplace_back(from, to, Move::Promotion::queen_promo);
+                        move_list.emplace_back(from, to, Move::Promotion::rook_promo);
+                        move_list.emplace_back(from, to, Move::Promotion::horse_promo);
+                        move_list.emplace_back(from, to, Move::Promotion::bishop_promo);
+                } else {
+                        move_list.emplace_back(from, to);
+                }
+        };
 
-                        Field weak_straights = 0ull;
-                        Field weak_diags     = 0ull;
+        const Field straight_sliders = pos.rooks<col>()   | pos.queen<col>();
+        const Field diagonal_sliders = pos.bishops<col>() | pos.queen<col>();
 
-                        // const Field weak_straights = get_weakly_blocked_straights(active_attacker, total);
-                        // const Field weak_diags     = get_weakly_blocked_diagonals(active_attacker, total);
+        // the pieces that can capture the checker are exactly the pieces
+        // the checker would see if it were that piece itself
+        const Field pawn_area = is_white ? (shifted<southEast>(checker) | shifted<southWest>(checker))
+                                         : (shifted<northEast>(checker) | shifted<northWest>(checker));
 
-                        // todo is this less eficient than just blindly checking king & ray?
-                        bool found_king = false;
+        const Field capturing_pawns  = pos.pawns<col>() & pawn_area;
+        const Field capturing_pieces = (pos.horses<col>() & get_horse_jumps(checker))
+                                     | (straight_sliders & get_weakly_blocked_straights(checker, total))
+                                     | (diagonal_sliders & get_weakly_blocked_diagonals(checker, total));
 
-                        // routine that looks at a ray, starting from the attacker in a direction
-                        // and if the king is there, sets the block_area
-                        auto handle_ray = [&]<Direction dir>() -> void {
-                                const Field ray = get_weakly_blocked_ray<dir>(active_attacker, total);
-                                if (!found_king && king & ray) {
-                                        found_king = true;
-                                        block_area = ray & ~king;
-                                }
+        for (Field f = capturing_pawns; f; f &= f - 1) {
+                const OneSquare from = lowest_square(f);
+                if (!pins.prevents(from, checker))
+                        push_pawn_move(from, checker);
+        }
 
-                                if constexpr (is_straight(dir)) {
-                                        weak_straights |= ray;
-                                } else {
-                                        weak_diags |= ray;
-                                }
-                        };
+        for (Field f = capturing_pieces; f; f &= f - 1) {
+                const OneSquare from = lowest_square(f);
+                if (!pins.prevents(from, checker))
+                        move_list.emplace_back(from, checker);
+        }
 
-                        handle_ray.template operator()<north>();
-                        handle_ray.template operator()<east>();
-                        handle_ray.template operator()<south>();
-                        handle_ray.template operator()<west>();
-                        handle_ray.template operator()<northEast>();
-                        handle_ray.template operator()<southEast>();
-                        handle_ray.template operator()<southWest>();
-                        handle_ray.template operator()<northWest>();
+        // if a slider gives check from a distance, we can block it
+        // the squares in between are exactly the squares that both the king
+        // and the checker would see as that slider
+        Field block_area = 0ull;
+        if (checker & (pos.rooks<other_col>() | pos.queen<other_col>()) & get_free_straights(king)) {
+                block_area = get_weakly_blocked_straights(king, total) & get_weakly_blocked_straights(checker, total);
+        } else if (checker & (pos.bishops<other_col>() | pos.queen<other_col>()) & get_free_diagonals(king)) {
+                block_area = get_weakly_blocked_diagonals(king, total) & get_weakly_blocked_diagonals(checker, total);
+        }
 
-                        // here, block_area, weak_straights, weak_diags have been set
-                        // the attack is blockable <==> block_area != 0;
-                        const Field horse_area     = get_horse_jumps(active_attacker);
-                        const Field pawn_area      = is_white ? (shifted<southEast>(active_attacker) | shifted<southWest>(active_attacker))
-                                                              : (shifted<northEast>(active_attacker) | shifted<northWest>(active_attacker));
-                        const Field king_area      = get_king_area(active_attacker) ;
+        // en passant either captures a checking pawn that just moved 2 forward,
+        // or lands in between a slider and the king
+        const Field two_moved_pawn = msk::file[pos.meta.pawn2fwd_file()] & en_passant_rank;
+        if (two_moved_pawn && !pins.en_passant_pinned) {
+                const OneSquare to = OneSquare_unsafe(shifted<ahead>(two_moved_pawn));
+                if (checker & two_moved_pawn || to & block_area) {
+                        const Field en_passant_squares = shifted<east>(two_moved_pawn) | shifted<west>(two_moved_pawn);
+                        for (Field f = pos.pawns<col>() & en_passant_squares; f; f &= f - 1) {
+                                const OneSquare from = lowest_square(f);
+                                if (!pins.prevents(from, to))
+                                        move_list.emplace_back(from, to, Move::EnPassant);
+                        }
+                }
+        }
 
-                        // if the attacking piece is a pawn that just moved 2 forward, there are some additional places
-                        // that a pawn can stand on to capture this pawn
+        push_king_moves(king_available & all_hostile);
 
-                        // we can only capture en passant if this indeed removes the check
-                        const Field en_passant_area   = (active_attacker & two_moved_pawn) ? en_passant_squares : 0ull;
+        if (block_area) {
+                // pawns block by moving forward, all at once
+                const Field one_ahead = shifted<ahead>(pos.pawns<col>()) & ~total;
+                const Field two_ahead = shifted<ahead>(one_ahead & third_rank) & ~total;
 
-                        // these are exactly the candidates in position to capture the attacker
-                        const Field candidate_rooks   = pos.rooks<col>()   & weak_straights;
-                        const Field candidate_bishops = pos.bishops<col>() & weak_diags;
-                        const Field candidate_queens  = pos.queen<col>()   & (weak_diags | weak_straights);
-                        const Field candidate_horses  = pos.horses<col>()  & horse_area;
-                        const Field candidate_pawns   = pos.pawns<col>()   & pawn_area;
-                        const Field candidate_kings   = pos.king<col>()    & king_area;
-                        // we'll treat en passant captures as special cases
-                        const Field candidate_en_passant_pawns = pos.pawns<col>() & en_passant_area;
+                for (Field f = one_ahead & block_area; f; f &= f - 1) {
+                        const OneSquare to   = lowest_square(f);
+                        const OneSquare from = OneSquare_unsafe(shifted<behind>(to));
+                        if (!pins.prevents(from, to))
+                                push_pawn_move(from, to);
+                }
 
-                        const Field all_candidates = candidate_rooks  | candidate_bishops | candidate_queens
-                                                   | candidate_horses | candidate_pawns   | candidate_kings | candidate_en_passant_pawns;
+                for (Field f = two_ahead & block_area; f; f &= f - 1) {
+                        const OneSquare to   = lowest_square(f);
+                        const OneSquare from = OneSquare_unsafe(shifted<behind>(shifted<behind>(to)));
+                        if (!pins.prevents(from, to))
+                                move_list.emplace_back(from, to);
+                }
 
+                // adds the moves of one piece into the block area
+                auto push_blocks = [&](const OneSquare from, const Field available) -> void {
+                        for (Field f = available & block_area; f; f &= f - 1) {
+                                const OneSquare to = lowest_square(f);
+                                if (!pins.prevents(from, to))
+                                        move_list.emplace_back(from, to);
+                        }
+                };
 
-                        // first we add the moves that capture the attacker
-                        // king moves here are counted as EVASIONS, because that is easier
-                        for (const OneSquare &from : all_squares) {
-                                bool is_en_passant = false;
+                // a queen can be in both loops, but never reaches the same square twice
+                for (Field f = pos.horses<col>(); f; f &= f - 1) {
+                        const OneSquare from = lowest_square(f);
+                        push_blocks(from, get_horse_jumps(from));
+                }
+                for (Field f = straight_sliders; f; f &= f - 1) {
+                        const OneSquare from = lowest_square(f);
+                        push_blocks(from, get_weakly_blocked_straights(from, total));
+                }
+                for (Field f = diagonal_sliders; f; f &= f - 1) {
+                        const OneSquare from = lowest_square(f);
+                        push_blocks(from, get_weakly_blocked_diagonals(from, total));
+                }
+        }
 
-                                if ((from & all_candidates) == 0ull)
-                                        continue;
+        push_king_moves(king_available & ~all_hostile);
+}
 
-                                if (from & king)
-                                        continue;
+template <Color col>
+inline
+// auto generate_moves_sorted (const Position &pos, MoveList &move_list) -> void
+auto generate_moves (const Position &pos, MoveList &move_list) -> void
+{
+        // not micro optimized
 
-                                // we set the en passant flag if applicable
-                                // en passant captures are pinned slightly differently
-                                if (from & candidate_en_passant_pawns) {
-                                        // const Field to_= shifted<ahead>(active_attacker);
-                                        // const OneSquare &to = *reinterpret_cast<const OneSquare *>(&to_);
-                                        const OneSquare to = OneSquare_unsafe(shifted<ahead>(active_attacker));
+        assert(pos.occupation_is_consistent());
+        assert(pos.mailbox_is_consistent());
 
-                                        if (en_passant_pinned || pin_prevents(from, to)) {
-                                                continue;
-                                        }
-                                        is_en_passant = true;
-                                        // the en passant pawn can be pinned as well
-                                } else if (pin_prevents(from, active_attacker)) {
-                                        // we still have to consider normal pins
-                                        continue;
-                                }
+        constexpr bool is_white = col == Color::white;
+        constexpr Color other_col = !col;
+        const Field all_friendly = pos.get_occupation<col>();
+        const Field all_hostile  = pos.get_occupation<other_col>();
+        const Field total = pos.get_total_occupation();        // has all non-empty squares
 
-                                // now we add the move, since it is clearly allowed
-                                if (from & candidate_pawns & second_back_rank) {
-                                        captures.emplace_back(from, active_attacker, Move::Promotion::queen_promo);
-                                        captures.emplace_back(from, active_attacker, Move::Promotion::rook_promo);
-                                        captures.emplace_back(from, active_attacker, Move::Promotion::horse_promo);
-                                        captures.emplace_back(from, active_attacker, Move::Promotion::bishop_promo);
-                                } else if (is_en_passant) {
-                                        const Field to = shifted<is_white ? north : south>(active_attacker);
-                                        // move_list.emplace_back(from, *reinterpret_cast<const OneSquare *>(&to), Move::EnPassant);
-                                        captures.emplace_back(from, OneSquare_unsafe(to), Move::EnPassant);
+        const OneSquare king = OneSquare_unsafe(pos.king<col>());
 
-                                } /* else if (from & king) {
-                                        // the king may not capture a defended piece
-                                        if ((active_attacker & pos.defend_map<other_col>()) == 0ull) {
-                                                move_list.emplace_back(from, active_attacker);
-                                        }
-                                } */
-                                else {
-                                        move_list.emplace_back(from, active_attacker);
-                                }
-                        }
+        // first we see if the king is in check
+        // in that case a dedicated generator only looks at the moves that resolve it
+        const Field straight_attackers = pos.rooks<other_col>() | pos.queen<other_col>();
+        const Field diagonal_attackers = pos.bishops<other_col>() | pos.queen<other_col>();
+        const Field pawn_attacked_area = is_white ? (shifted<northEast>(king) | shifted<northWest>(king))
+                                                  : (shifted<southEast>(king) | shifted<southWest>(king));
 
-                        // now we add the moves that block the attack
-                        // this is of course not always possible, such as with a knight attack or if
-                        // there is a piece right next to the king
+        const Field checkers = (pos.horses<other_col>() & get_horse_jumps(king))
+                             | (diagonal_attackers & get_weakly_blocked_diagonals(king, total))
+                             | (straight_attackers & get_weakly_blocked_straights(king, total))
+                             | (pos.pawns<other_col>() & pawn_attacked_area);
 
+        if (checkers) {
+                generate_evasions<col>(pos, checkers, move_list);
+                return;
+        }
 
-                        if (block_area) for (const OneSquare &from : all_squares) {
-                                if ((from & all_friendly) == 0ull)
-                                        continue;
+        // move sorting is important for the algorithm, so we sort
+        // different kinds of moves into different lists
+        // we merge them all before returning
+        MoveList captures;
+        MoveList quiets;
 
-                                if (from & pos.pawns<col>()) {
-                                        // 1 fwd, 2 fwd, en passant capture are all things that can block the check
-                                        // normal captures can not
+        // pushes the move onto the movelist, in an optimal order
+        auto push_list = [&]() -> void {
+                for (const Move capture : captures)
+                        move_list.emplace_back(capture);
+                for (const Move quiet : quiets)
+                        move_list.emplace_back(quiet);
+        };
 
-                                        // 1 fwd is always allowed
-                                        // if the square ahead it in block_area, it is automatically free as well
-                                        // const Field one_ahead_ = shifted<ahead>(from);
-                                        // const OneSquare &one_ahead = *reinterpret_cast<const OneSquare *>(&one_ahead_);
-                                        const OneSquare one_ahead = OneSquare_unsafe(shifted<ahead>(from));
+        constexpr Field en_passant_rank  = msk::rank[is_white ? 4 : 3];
+        constexpr Field back_rank        = msk::rank[is_white ? 7 : 0];
+        constexpr Field second_rank      = msk::rank[is_white ? 1 : 6];
+        constexpr Direction ahead = is_white ? north : south;
 
-                                        const bool pinned_one_ahead = pin_prevents(from, one_ahead);
-                                        if (one_ahead & block_area && !pinned_one_ahead) {
-                                                if (one_ahead & back_rank) {
-                                                        blocks.emplace_back(from, one_ahead, Move::Promotion::queen_promo);
-                                                        blocks.emplace_back(from, one_ahead, Move::Promotion::rook_promo);
-                                                        blocks.emplace_back(from, one_ahead, Move::Promotion::horse_promo);
-                                                        blocks.emplace_back(from, one_ahead, Move::Promotion::bishop_promo);
-                                                } else {
-                                                        blocks.emplace_back(from, one_ahead);
-                                                }
-                                        }
+        // is 0 if there is none
+        const Field two_moved_pawn = msk::file[pos.meta.pawn2fwd_file()] & en_passant_rank;
 
-                                        if (from & second_rank && !pinned_one_ahead) {
-                                                // we do not even have to check if this is pinned
-                                                const Field two_ahead = shifted<ahead>(one_ahead);
-                                                if ((one_ahead & total) == 0ull && two_ahead & block_area) {
-                                                        // move_list.emplace_back(from, *reinterpret_cast<const OneSquare *>(&two_ahead));
-                                                        blocks.emplace_back(from, OneSquare_unsafe(two_ahead));
-                                                }
-                                        } else if (from & en_passant_squares && !en_passant_pinned) {
-                                                // en passant is an option
-                                                const OneSquare to = OneSquare_unsafe(shifted<ahead>(two_moved_pawn));
-                                                if (!pin_prevents(from, to) && to & block_area) {
-                                                        blocks.emplace_back(from, to, Move::EnPassant);
-                                                }
-                                        }
-                                        continue;
-                                }
-                                Field available = 0ull;
-                                if (from & pos.rooks<col>()) {
-                                        available = get_weakly_blocked_straights(from, total);
-                                } else if (from & pos.bishops<col>()) {
-                                        available = get_weakly_blocked_diagonals(from, total);
-                                } else if (from & pos.queen<col>()) {
-                                        available = get_weakly_blocked_straights(from, total);
-                                        available |= get_weakly_blocked_diagonals(from, total);
-                                } else if (from & pos.horses<col>()) {
-                                        available = get_horse_jumps(from);
-                                }
-                                available &= block_area;
-                                for (const OneSquare &to : all_squares) {
-                                        if ((to & available) == 0ull)
-                                                continue;
-                                        if (pin_prevents(from, to))
-                                                continue;
-                                        blocks.emplace_back(from, to);
-                                }
-                        }
-                        // the other moves to save the king are evasions
-                        // these also work if there are more attackers
-                }
+        // contains the squares that can capture a pawn en passant, if any
+        const Field en_passant_squares = shifted<east>(two_moved_pawn) | shifted<west>(two_moved_pawn);
 
-                // evasions are the only remaining option
-                // of course the king cannot stop the attack ray, since he has to step aside
-                Position pos_without_king = pos;
-                pos_without_king.king<col>() ^= king;
-                const Field defend_map = pos_without_king.defend_map<other_col>();
-                const Field available  = get_king_area(king) & (~all_friendly) & (~defend_map);
-                for (const OneSquare &to : all_squares) {
-                        if (to & available) {
-                                quiets.emplace_back(king, to);
-                        }
-                }
-                // no other moves can be made
-                push_list();
-                return;
-        }
+        const PinInfo pins = calculate_pins<col>(pos);
 
         const Field straight_sliders = pos.rooks<col>()   | pos.queen<col>();
         const Field diagonal_sliders = pos.bishops<col>() | pos.queen<col>();
@@ -1886,7 +1869,7 @@ auto generate_moves (const Position &pos, MoveList &move_list) -> void
                         const OneSquare one_ahead = OneSquare_unsafe(shifted<ahead>(from));
 
                         if ((total & one_ahead) == 0ull) {
-                                const bool pinned_one_ahead = pin_prevents(from, one_ahead);
+                                const bool pinned_one_ahead = pins.prevents(from, one_ahead);
                                 if (!pinned_one_ahead) {
                                         // now we add the move
                                         if (one_ahead & back_rank) {
@@ -1914,7 +1897,7 @@ auto generate_moves (const Position &pos, MoveList &move_list) -> void
                         const Field rcapture_ = shifted<is_white ? northEast : southEast>(from);
 
                         // if (lcapture_ & all_hostile && !pin_prevents(from, *reinterpret_cast<const OneSquare *>(&lcapture_))) {
-                        if (lcapture_ & all_hostile && !pin_prevents(from, OneSquare_unsafe(lcapture_))) {
+                        if (lcapture_ & all_hostile && !pins.prevents(from, OneSquare_unsafe(lcapture_))) {
 
                                 const OneSquare lcapture = OneSquare_unsafe(lcapture_);
                                 if (lcapture & back_rank) {
@@ -1926,7 +1909,7 @@ auto generate_moves (const Position &pos, MoveList &move_list) -> void
                                         captures.emplace_back(from, lcapture);
                                 }
                         }
-                        if (rcapture_ & all_hostile && !pin_prevents(from, OneSquare_unsafe(rcapture_))) {
+                        if (rcapture_ & all_hostile && !pins.prevents(from, OneSquare_unsafe(rcapture_))) {
                                 const OneSquare rcapture = OneSquare_unsafe(rcapture_);
 
                                 if (rcapture & back_rank) {
@@ -1941,11 +1924,11 @@ auto generate_moves (const Position &pos, MoveList &move_list) -> void
 
                         // en passant is subject to some more constraints
                         // most of these are already dealt with in en_passant_pinned
-                        if (from & en_passant_squares && !en_passant_pinned) {
+                        if (from & en_passant_squares && !pins.en_passant_pinned) {
                                 // const Field to_ = shifted<ahead>(two_moved_pawn);
                                 // const OneSquare &to = *reinterpret_cast<const OneSquare *>(&to_);
                                 const OneSquare to = OneSquare_unsafe(shifted<ahead>(two_moved_pawn));
-                                if (!pin_prevents(from, to)) {
+                                if (!pins.prevents(from, to)) {
                                         captures.emplace_back(from, to, Move::EnPassant);
                                 }
                         }
@@ -2005,7 +1988,7 @@ auto generate_moves (const Position &pos, MoveList &move_list) -> void
                         if ((to & available) == 0ull)
                                 continue;
 
-                        if (pin_prevents(from, to))
+                        if (pins.prevents(from, to))
                                 continue;
 
                         if (to & all_hostile) {
@@ -0,0 +1,180 @@
+//
+// Created by Hugo Bogaart on 18/10/2026.
+//
+
+#include "nnue.h"
+#include <algorithm>
+#include <fstream>
+#include <immintrin.h>
+
+namespace Nnue {
+
+auto load_network (const std::string &path) -> std::unique_ptr<Network>
+{
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file || static_cast<size_t>(file.tellg()) != file_size)
+                return nullptr;
+        file.seekg(0);
+
+        // the file is little endian, like the machines we run on
+        auto net = std::make_unique<Network>();
+        auto read = [&](int16_t *dest, size_t count) {
+                file.read(reinterpret_cast<char *>(dest), static_cast<std::streamsize>(count * sizeof(int16_t)));
+        };
+        read(&net->feature_weights[0][0], num_features * hidden_size);
+        read(net->feature_bias, hidden_size);
+        read(&net->output_weights[0][0], 2 * hidden_size);
+        read(&net->output_bias, 1);
+
+        if (!file)
+                return nullptr;
+        return net;
+}
+
+// adds the columns of the added features to src, subtracts those of the removed ones, and writes it to dest
+// a move changes at most 4 squares, so there are at most 4 of each
+static
+auto add_sub_columns (const int16_t *src, int16_t *dest, const int16_t *const *adds, int num_adds,
+                      const int16_t *const *subs, int num_subs) -> void
+{
+#ifdef __AVX2__
+        // 16 values in a register, the whole accumulator of one side is 16 registers
+        for (size_t i = 0; i < hidden_size; i += 16) {
+                __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(src + i));
+                for (int j = 0; j < num_adds; j++)
+                        v = _mm256_add_epi16(v, _mm256_load_si256(reinterpret_cast<const __m256i *>(adds[j] + i)));
+                for (int j = 0; j < num_subs; j++)
+                        v = _mm256_sub_epi16(v, _mm256_load_si256(reinterpret_cast<const __m256i *>(subs[j] + i)));
+                _mm256_store_si256(reinterpret_cast<__m256i *>(dest + i), v);
+        }
+#elif defined(__SSE2__)
+        for (size_t i = 0; i < hidden_size; i += 8) {
+                __m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(src + i));
+                for (int j = 0; j < num_adds; j++)
+                        v = _mm_add_epi16(v, _mm_load_si128(reinterpret_cast<const __m128i *>(adds[j] + i)));
+                for (int j = 0; j < num_subs; j++)
+                        v = _mm_sub_epi16(v, _mm_load_si128(reinterpret_cast<const __m128i *>(subs[j] + i)));
+                _mm_store_si128(reinterpret_cast<__m128i *>(dest + i), v);
+        }
+#else
+        for (size_t i = 0; i < hidden_size; i++) {
+                int16_t v = src[i];
+                for (int j = 0; j < num_adds; j++)
+                        v = static_cast<int16_t>(v + adds[j][i]);
+                for (int j = 0; j < num_subs; j++)
+                        v = static_cast<int16_t>(v - subs[j][i]);
+                dest[i] = v;
+        }
+#endif
+}
+
+// the sum over the accumulator of clipped_relu(value) * weight
+static
+auto clipped_relu_dot (const int16_t *acc, const int16_t *weights) -> int64_t
+{
+#ifdef __AVX2__
+        // a lane sums 32 products of at most 255 * 2^15, so int32 does not overflow
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i max = _mm256_set1_epi16(qa);
+        __m256i sum = _mm256_setzero_si256();
+        for (size_t i = 0; i < hidden_size; i += 16) {
+                __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc + i));
+                v = _mm256_min_epi16(_mm256_max_epi16(v, zero), max);
+                const __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i *>(weights + i));
+                sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, w));
+        }
+        alignas(32) int32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), sum);
+        int64_t total = 0;
+        for (const int32_t lane : lanes)
+                total += lane;
+        return total;
+#elif defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i max = _mm_set1_epi16(qa);
+        __m128i sum = _mm_setzero_si128();
+        for (size_t i = 0; i < hidden_size; i += 8) {
+                __m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(acc + i));
+                v = _mm_min_epi16(_mm_max_epi16(v, zero), max);
+                const __m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(weights + i));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(v, w));
+        }
+        alignas(16) int32_t lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), sum);
+        return static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+#else
+        int64_t total = 0;
+        for (size_t i = 0; i < hidden_size; i++)
+                total += std::clamp<int32_t>(acc[i], 0, qa) * weights[i];
+        return total;
+#endif
+}
+
+auto refresh (const Network &net, const Position &pos, Accumulator &acc) -> void
+{
+        for (const Color perspective : {Color::black, Color::white}) {
+                int16_t *values = acc.values[static_cast<int>(perspective)];
+                std::copy_n(net.feature_bias, hidden_size, values);
+                for (int sh = 0; sh < 64; sh++) {
+                        const Epiece pc = pos.mailbox[sh];
+                        if (pc == no_piece)
+                                continue;
+                        const int16_t *column = net.feature_weights[feature_index(perspective, pc, sh)];
+                        add_sub_columns(values, values, &column, 1, nullptr, 0);
+                }
+        }
+}
+
+auto update (const Network &net, const Position &before, const Position &after, const Accumulator &parent, Accumulator &child) -> void
+{
+        // the squares where the mailbox changed, bit i for square shift i
+#ifdef __AVX2__
+        auto unchanged_mask = [&](int offset) -> uint32_t {
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(before.mailbox + offset));
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(after.mailbox + offset));
+                return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+        };
+        const uint64_t changed = ~(static_cast<uint64_t>(unchanged_mask(32)) << 32 | unchanged_mask(0));
+#else
+        uint64_t changed = 0;
+        for (int sh = 0; sh < 64; sh++) {
+                if (before.mailbox[sh] != after.mailbox[sh])
+                        changed |= 1ull << sh;
+        }
+#endif
+
+        for (const Color perspective : {Color::black, Color::white}) {
+                const int16_t *adds[4];
+                const int16_t *subs[4];
+                int num_adds = 0;
+                int num_subs = 0;
+                for (uint64_t f = changed; f; f &= f - 1) {
+                        const int sh = trailing_0_count(f);
+                        if (before.mailbox[sh] != no_piece && num_subs < 4)
+                                subs[num_subs++] = net.feature_weights[feature_index(perspective, before.mailbox[sh], sh)];
+                        if (after.mailbox[sh] != no_piece && num_adds < 4)
+                                adds[num_adds++] = net.feature_weights[feature_index(perspective, after.mailbox[sh], sh)];
+                }
+                const int idx = static_cast<int>(perspective);
+                add_sub_columns(parent.values[idx], child.values[idx], adds, num_adds, subs, num_subs);
+        }
+}
+
+auto evaluate (const Network &net, const Accumulator &acc, Color active) -> Eval
+{
+        const int64_t sum = clipped_relu_dot(acc.values[static_cast<int>(active)], net.output_weights[0])
+                          + clipped_relu_dot(acc.values[static_cast<int>(!active)], net.output_weights[1]);
+
+        // from the perspective of the side to move
+        const int64_t active_eval = (sum / qa + net.output_bias) * eval_scale / (qa * qb);
+        return truncated(static_cast<Eval>(active == Color::white ? active_eval : -active_eval));
+}
+
+auto evaluate (const Network &net, const Position &pos) -> Eval
+{
+        Accumulator acc;
+        refresh(net, pos, acc);
+        return evaluate(net, acc, pos.meta.active);
+}
+
+}
@@ -0,0 +1,114 @@
+//
+// Created by Hugo Bogaart on 18/10/2026.
+//
+
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "position.h"
+#include "eval.h"
+#include "gen-defs.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// an efficiently updatable neural network, as an alternative to the classical static_eval
+//
+// the inputs are the 768 (piece, square) pairs, seen from both sides
+// these go to an accumulator of hidden_size values for each side, then clipped relu, then to one output
+//
+// the accumulator is the sum of the weights of the pieces on the board,
+// so after a move only the columns of the squares that changed are added or subtracted
+namespace Nnue {
+
+constexpr size_t num_features = 768;
+constexpr size_t hidden_size = 256;
+
+// quantisation, the accumulator is scaled by qa and the output weights by qb
+// the output times eval_scale is in centipawns
+constexpr int32_t qa = 255;
+constexpr int32_t qb = 64;
+constexpr int32_t eval_scale = 400;
+
+// the side looking at the board sees its own pieces as white, from its own side of the board
+// the shift of the square is mirrored vertically for black
+constexpr
+auto feature_index (Color perspective, Epiece pc, int sh) -> size_t
+{
+        if (perspective == Color::white)
+                return static_cast<size_t>(pc) * 64 + sh;
+
+        // white_king .. white_pawns is 0 .. 5, black is 6 .. 11
+        const size_t swapped = (static_cast<size_t>(pc) + 6) % 12;
+        return swapped * 64 + (sh ^ 56);
+}
+
+// the file holds these as little endian int16, in this order and without padding
+struct Network {
+        alignas(64) int16_t feature_weights[num_features][hidden_size];
+        alignas(64) int16_t feature_bias[hidden_size];
+
+        // [0] for the side to move, [1] for the other side
+        alignas(64) int16_t output_weights[2][hidden_size];
+        int16_t output_bias;
+};
+
+// the number of bytes of a network file
+constexpr size_t file_size = sizeof(int16_t) * (num_features * hidden_size + hidden_size + 2 * hidden_size + 1);
+
+// reads a network file, nullptr if it can not be read or has the wrong size
+auto load_network (const std::string &path) -> std::unique_ptr<Network>;
+
+struct Accumulator {
+        // indexed by the color of the perspective
+        alignas(64) int16_t values[2][hidden_size];
+};
+
+// calculates the accumulator from all pieces on the board
+auto refresh (const Network &net, const Position &pos, Accumulator &acc) -> void;
+
+// calculates the accumulator of the position after a move from the one before it
+// only the squares where the mailbox differs are looked at, so this works for every kind of move
+auto update (const Network &net, const Position &before, const Position &after, const Accumulator &parent, Accumulator &child) -> void;
+
+// the eval of the position of the accumulator, white positive like static_eval
+auto evaluate (const Network &net, const Accumulator &acc, Color active) -> Eval;
+
+// refreshes and evaluates
+auto evaluate (const Network &net, const Position &pos) -> Eval;
+
+// the accumulators of the line that is being searched, one for each ply
+// push when making a move, pop when undoing it
+class AccumulatorStack {
+
+        std::vector<Accumulator> accumulators = std::vector<Accumulator>(128);
+        size_t top_idx = 0;
+
+public:
+        auto reset (const Network &net, const Position &root) -> void
+        {
+                top_idx = 0;
+                refresh(net, root, accumulators[0]);
+        }
+
+        auto push (const Network &net, const Position &before, const Position &after) -> void
+        {
+                if (top_idx + 1 == accumulators.size())
+                        accumulators.resize(2 * accumulators.size());
+                update(net, before, after, accumulators[top_idx], accumulators[top_idx + 1]);
+                top_idx++;
+        }
+
+        auto pop () -> void
+        {
+                assert(top_idx > 0);
+                top_idx--;
+        }
+
+        auto top () const -> const Accumulator & {return accumulators[top_idx];}
+};
+
+}
+
+#endif //NNUE_H
@@ -0,0 +1,122 @@
+//
+// Created by Hugo Bogaart on 18/10/2026.
+//
+
+#include "perft.h"
+#include <thread>
+
+auto perft (const Position &pos, const int depth) -> size_t
+{
+        const PositionHashPair pos_hash{pos, zobrist_hash(pos)};
+        if (pos.meta.active == Color::white)
+                return perft_col<Color::white>(pos_hash, depth);
+        return perft_col<Color::black>(pos_hash, depth);
+}
+
+template <Color col>
+auto divide_col (const PositionHashPair &pos_hash, const int depth) -> std::vector<DivideEntry>
+{
+        MoveList mlist;
+        generate_moves<col>(pos_hash.pos, mlist);
+
+        std::vector<DivideEntry> entries;
+        entries.reserve(mlist.size());
+        for (Move mv : mlist) {
+                PositionHashPair copy = pos_hash;
+                make_move_unsafe<col>(mv, copy);
+                entries.emplace_back(mv, perft_col<!col>(copy, depth - 1));
+        }
+        return entries;
+}
+
+auto divide (const Position &pos, const int depth) -> std::vector<DivideEntry>
+{
+        if (depth <= 0)
+                return {};
+
+        const PositionHashPair pos_hash{pos, zobrist_hash(pos)};
+        if (pos.meta.active == Color::white)
+                return divide_col<Color::white>(pos_hash, depth);
+        return divide_col<Color::black>(pos_hash, depth);
+}
+
+
+// a subtree that is counted by a single thread
+struct PerftWork {
+        PositionHashPair pos_hash;
+        Color active;
+};
+
+template <Color col>
+auto collect_work (const PositionHashPair &pos_hash, int ply, std::vector<PerftWork> &work) -> void
+{
+        if (ply == 0) {
+                work.emplace_back(pos_hash, col);
+                return;
+        }
+
+        MoveList mlist;
+        generate_moves<col>(pos_hash.pos, mlist);
+        for (Move mv : mlist) {
+                PositionHashPair copy = pos_hash;
+                make_move_unsafe<col>(mv, copy);
+                collect_work<!col>(copy, ply - 1, work);
+        }
+}
+
+auto parallel_perft (const Position &pos, const int depth, const size_t num_threads, PerftTable *table) -> size_t
+{
+        if (num_threads <= 1 || depth <= 2) {
+                if (!table)
+                        return perft(pos, depth);
+                const PositionHashPair pos_hash{pos, zobrist_hash(pos)};
+                if (pos.meta.active == Color::white)
+                        return perft_hashed_col<Color::white>(pos_hash, depth, *table);
+                return perft_hashed_col<Color::black>(pos_hash, depth, *table);
+        }
+
+        // about 4 subtrees a thread evens out the uneven sizes of the subtrees
+        const PositionHashPair root{pos, zobrist_hash(pos)};
+        std::vector<PerftWork> work;
+        int split_ply = 0;
+        while (work.size() < 4 * num_threads && split_ply < depth - 1) {
+                split_ply++;
+                work.clear();
+                if (pos.meta.active == Color::white)
+                        collect_work<Color::white>(root, split_ply, work);
+                else
+                        collect_work<Color::black>(root, split_ply, work);
+        }
+
+        const int sub_depth = depth - split_ply;
+        std::atomic<size_t> next_work = 0;
+        std::atomic<size_t> total = 0;
+
+        auto worker = [&]() -> void {
+                size_t count = 0;
+                for (size_t i = next_work++; i < work.size(); i = next_work++) {
+                        const PerftWork &w = work[i];
+                        if (table) {
+                                count += w.active == Color::white
+                                        ? perft_hashed_col<Color::white>(w.pos_hash, sub_depth, *table)
+                                        : perft_hashed_col<Color::black>(w.pos_hash, sub_depth, *table);
+                        } else {
+                                count += w.active == Color::white
+                                        ? perft_col<Color::white>(w.pos_hash, sub_depth)
+                                        : perft_col<Color::black>(w.pos_hash, sub_depth);
+                        }
+                }
+                total += count;
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads - 1);
+        for (size_t i = 1; i < num_threads; i++)
+                threads.emplace_back(worker);
+        // this thread works as well
+        worker();
+        for (std::thread &t : threads)
+                t.join();
+
+        return total;
+}
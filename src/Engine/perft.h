@@ -0,0 +1,130 @@
+//
+// Created by Hugo Bogaart on 18/10/2026.
+//
+
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "position.h"
+#include "movegen.h"
+#include "zobrist-hash.h"
+#include "transtable.h"
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+// counts the leaf nodes of the legal move tree up to some depth
+// the moves are legal, so the last ply is bulk counted: the size of the move list is the amount of leaves
+// the hash is carried along so it is the same make move as in the search
+template <Color col>
+auto perft_col (const PositionHashPair &pos_hash, int depth) -> size_t
+{
+        if (depth == 0)
+                return 1;
+
+        MoveList mlist;
+        generate_moves<col>(pos_hash.pos, mlist);
+        if (depth == 1)
+                return mlist.size();
+
+        size_t count = 0;
+        for (Move mv : mlist) {
+                PositionHashPair copy = pos_hash;
+                make_move_unsafe<col>(mv, copy);
+                count += perft_col<!col>(copy, depth - 1);
+        }
+        return count;
+}
+
+auto perft (const Position &pos, int depth) -> size_t;
+
+
+// lockless table of subtree counts, keyed by (hash, depth)
+// an entry is two independent atomics, the key is stored xor'ed with the data
+// so a torn write from two threads at once simply looks like a miss
+class PerftTable {
+public:
+        explicit PerftTable (size_t num_mbs)
+                : num_entries(std::max<size_t>(1, num_mbs * bytes_in_mb / sizeof (Entry))),
+                  table(std::make_unique<Entry[]>(num_entries))
+        { }
+
+        auto find (uint64_t hash, int depth) const -> std::optional<size_t>
+        {
+                const Entry &entry = table[index(hash, depth)];
+                const uint64_t data = entry.data.load(std::memory_order_relaxed);
+                const uint64_t key  = entry.key.load(std::memory_order_relaxed);
+                if ((key ^ data) != hash || (data & depth_mask) != static_cast<uint64_t>(depth))
+                        return std::nullopt;
+                return data >> depth_bits;
+        }
+
+        auto store (uint64_t hash, int depth, size_t count) -> void
+        {
+                // always replace, the deeper counts are stored last anyway
+                Entry &entry = table[index(hash, depth)];
+                const uint64_t data = (count << depth_bits) | static_cast<uint64_t>(depth);
+                entry.key.store(hash ^ data, std::memory_order_relaxed);
+                entry.data.store(data, std::memory_order_relaxed);
+        }
+
+private:
+        // the low byte of the data is the depth, the rest is the count
+        static constexpr int depth_bits = 8;
+        static constexpr uint64_t depth_mask = (1ull << depth_bits) - 1;
+
+        struct Entry {
+                std::atomic<uint64_t> key  = 0;
+                std::atomic<uint64_t> data = 0;
+        };
+
+        // the same position at another depth should land elsewhere
+        auto index (uint64_t hash, int depth) const -> size_t
+        {
+                return (hash ^ (static_cast<uint64_t>(depth) * 0x9e3779b97f4a7c15ull)) % num_entries;
+        }
+
+        size_t num_entries;
+        std::unique_ptr<Entry[]> table;
+};
+
+// perft that memoizes subtrees of depth 2 and up in the table
+template <Color col>
+auto perft_hashed_col (const PositionHashPair &pos_hash, int depth, PerftTable &table) -> size_t
+{
+        if (depth <= 1)
+                return perft_col<col>(pos_hash, depth);
+
+        if (const std::optional<size_t> count = table.find(pos_hash.hash, depth))
+                return *count;
+
+        MoveList mlist;
+        generate_moves<col>(pos_hash.pos, mlist);
+
+        size_t count = 0;
+        for (Move mv : mlist) {
+                PositionHashPair copy = pos_hash;
+                make_move_unsafe<col>(mv, copy);
+                count += perft_hashed_col<!col>(copy, depth - 1, table);
+        }
+        table.store(pos_hash.hash, depth, count);
+        return count;
+}
+
+// splits the tree at the first ply that gives every thread a few subtrees
+// and lets the threads take subtrees until there are none left
+// without a table the threads share nothing
+auto parallel_perft (const Position &pos, int depth, size_t num_threads, PerftTable *table = nullptr) -> size_t;
+
+
+struct DivideEntry {
+        Move move;
+        size_t nodes;
+};
+
+// the perft count below each root move, handy to find which move the movegen gets wrong
+auto divide (const Position &pos, int depth) -> std::vector<DivideEntry>;
+
+#endif //PERFT_H
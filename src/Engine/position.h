@@ -15,6 +15,7 @@
 
 #include "gen-defs.h"
 #include "bitfield.h"
+#include "eval-params.h"
 
 #include <vector>
 #include <algorithm>
@@ -25,6 +26,19 @@
 constexpr CalculationType horses_ct = CalculationType::lookup_table;
 constexpr CalculationType kings_ct  = CalculationType::lookup_table;
 
+// how attack_map and defend_map find the squares the sliders attack
+// lookup_table goes over the sliders one by one, the others do all sliders at once
+enum struct SliderAttacks {
+        lookup_table, kogge_stone, kogge_stone_avx2
+};
+
+// with avx2 the vectorized fill is the fastest, see the microbench
+#ifdef __AVX2__
+constexpr SliderAttacks slider_attacks_ct = SliderAttacks::kogge_stone_avx2;
+#else
+constexpr SliderAttacks slider_attacks_ct = SliderAttacks::lookup_table;
+#endif
+
 // the starting board
 constexpr Field start_board[12] = {
     0b0000000000000000000000000000000000000000000000000000000000010000,     // rank 0 file 4            white king
@@ -87,7 +101,10 @@ enum Epiece : uint8_t {
         black_horses,
         black_rooks,
         black_bishops,
-        black_pawns
+        black_pawns,
+
+        // an empty square in the mailbox
+        no_piece
 };
 
 
@@ -105,6 +122,135 @@ constexpr Color get_color(Epiece piece)
         }
 }
 
+// a midgame score in the low and an endgame score in the high 16 bits of one int32
+// adding or subtracting two of them adds or subtracts both halves at once
+typedef int32_t PackedScore;
+
+[[nodiscard]]
+constexpr auto make_score (int32_t mg, int32_t eg) -> PackedScore
+{
+        return static_cast<PackedScore>(static_cast<uint32_t>(eg) << 16) + mg;
+}
+
+// a negative midgame half borrows from the endgame half, the rounding in eg_value gives it back
+[[nodiscard]]
+constexpr auto mg_value (PackedScore score) -> int32_t
+{
+        return static_cast<int16_t>(static_cast<uint16_t>(static_cast<uint32_t>(score)));
+}
+
+[[nodiscard]]
+constexpr auto eg_value (PackedScore score) -> int32_t
+{
+        return static_cast<int16_t>(static_cast<uint16_t>((static_cast<uint32_t>(score) + 0x8000) >> 16));
+}
+
+static_assert(mg_value(make_score(3, -9) + make_score(-8, 2)) == -5 && eg_value(make_score(3, -9) + make_score(-8, 2)) == -7);
+
+// the game phase counts the pieces that are not pawns or kings, weighted by how much they matter
+// max_phase is all of them still on the board, 0 is a pawn ending
+constexpr int max_phase = 24;
+constexpr std::array<uint8_t, 13> piece_phase = {
+        0, 4, 1, 2, 1, 0,       // white king, queen, horses, rooks, bishops, pawns
+        0, 4, 1, 2, 1, 0,       // black
+        0                       // no_piece
+};
+
+// interpolates between the midgame and the endgame score by the phase
+// promotions can bring the phase above max_phase, that still counts as midgame
+[[nodiscard]]
+constexpr auto tapered (PackedScore score, int phase) -> int32_t
+{
+        const int mg_phase = std::min(phase, max_phase);
+        return (mg_value(score) * mg_phase + eg_value(score) * (max_phase - mg_phase)) / max_phase;
+}
+
+// the part of the eval that only depends on one piece and its square: material and placement
+// the board keeps the sum of these up to date with every move, so static_eval does not recount it
+// positive is good for white, so black pieces count negatively
+[[nodiscard]]
+constexpr PackedScore piece_square_value(const Epiece pc, const int sh)
+{
+        const Field sq = square_from_shift(sh);
+        const bool is_white = get_color(pc) == Color::white;
+
+        auto rel_rank = [&](int r) -> Field {
+                return is_white ? msk::rank[r] : msk::rank[7 - r];
+        };
+        auto on = [&](Field f) -> int32_t {
+                return (sq & f) != 0;
+        };
+
+        auto ring = [&]() -> int {
+                for (int r = 0; r < 3; r++) {
+                        if (sq & msk::ring[r])
+                                return r;
+                }
+                return 3;
+        };
+
+        int32_t mg = 0;
+        int32_t eg = 0;
+        switch (pc) {
+        case white_king:
+        case black_king:
+                // king safety
+                mg += king_safety_2ndlastrank_val * on(msk::rank[1] | msk::rank[6]);
+                mg += king_safety_2ndlastrank_val * on(msk::file[1] | msk::file[6]);
+                mg += king_safety_lastrank_val * on(msk::rank[0] | msk::rank[7]);
+                mg += king_safety_lastrank_val * on(msk::file[0] | msk::file[7]);
+                eg += king_ring_eg[ring()];
+                break;
+        case white_queen:
+        case black_queen:
+                mg += queen_val;
+                eg += queen_val;
+                break;
+        case white_rooks:
+        case black_rooks:
+                mg += rook_val;
+                eg += rook_val;
+                break;
+        case white_bishops:
+        case black_bishops:
+                mg += bishop_val;
+                eg += bishop_val;
+                break;
+        case white_horses:
+        case black_horses:
+                // horsies get penalty on the edges
+                mg += horse_val + horse_ring_mg[ring()];
+                eg += horse_val + horse_ring_eg[ring()];
+                break;
+        case white_pawns:
+        case black_pawns:
+                mg += pawn_val;
+                eg += pawn_val_eg;
+                // central pawns are worth more
+                mg += pawn_center_val * on(~msk::file[0] & ~msk::file[7]);
+                // and rook-file pawns less
+                mg -= rook_file_pawn_penalty * on(msk::file[0] | msk::file[7]);
+                // pawn promotion, which matters even more when there is less to stop them
+                mg += pawn_advanced_mg[0] * on(rel_rank(5));
+                mg += pawn_advanced_mg[1] * on(rel_rank(6));
+                eg += pawn_advanced_eg[0] * on(rel_rank(5));
+                eg += pawn_advanced_eg[1] * on(rel_rank(6));
+                break;
+        default:
+                break;
+        }
+        return is_white ? make_score(mg, eg) : make_score(-mg, -eg);
+}
+
+// piece_square_table[pc][sh], with an all zero row for no_piece
+constexpr auto piece_square_table = []() constexpr {
+        std::array<std::array<PackedScore, 64>, 13> table{};
+        for (int pc = white_king; pc <= black_pawns; pc++)
+                for (int sh = 0; sh < 64; sh++)
+                        table[pc][sh] = piece_square_value(static_cast<Epiece>(pc), sh);
+        return table;
+}();
+
 // prints out a field formatted like a chess board
 
 /*
@@ -201,6 +347,22 @@ struct PiecewiseBoard {
         // the enum values are the indices as well, so board[white_rooks] is the white rooks
         Field board[12];
 
+        // the squares occupied by white, black and by any piece
+        // these are kept in sync with board by place_piece, remove_piece and move_piece
+        // after editing board directly, update_occupation() must be called
+        Field white_occupation;
+        Field black_occupation;
+        Field total_occupation;
+
+        // the piece on each square, or no_piece, indexed by the shift of the square
+        // kept in sync with board in the same way, after editing board directly update_mailbox() must be called
+        Epiece mailbox[64];
+
+        // the sum of piece_square_value over all pieces, and of their piece_phase
+        // kept in sync with board in the same way, after editing board directly update_piece_square() must be called
+        PackedScore piece_square_score;
+        uint8_t phase;
+
         // only copies are made anyway
         constexpr PiecewiseBoard() = default;
         constexpr PiecewiseBoard(const PiecewiseBoard &other) = default;
@@ -214,14 +376,14 @@ struct PiecewiseBoard {
         // returns a field type that contains all squares that color col attacks
         // does not include the squares where its own pieces are standing in the way
 
-        template <Color col>
+        template <Color col, SliderAttacks sa = slider_attacks_ct>
         [[nodiscard, gnu::pure]]
         constexpr
         Field attack_map() const;
 
         // returns a field type that contains all squares that color col attacks
         // also includes its own pieces that are defended
-        template <Color col>
+        template <Color col, SliderAttacks sa = slider_attacks_ct>
         [[nodiscard, gnu::pure]]
         constexpr
         Field defend_map() const;
@@ -232,6 +394,57 @@ struct PiecewiseBoard {
         constexpr
         Field get_occupation() const;
 
+        // returns a field with a 1 at each point any piece stands
+        [[nodiscard, gnu::pure]]
+        constexpr
+        Field get_total_occupation() const;
+
+        // recalculates the occupation from the pieces on the board
+        constexpr
+        void update_occupation();
+
+        // returns true if the occupation agrees with the pieces on the board
+        // meant for asserts
+        [[nodiscard]]
+        constexpr
+        bool occupation_is_consistent() const;
+
+        // recalculates the mailbox from the pieces on the board
+        constexpr
+        void update_mailbox();
+
+        // returns true if the mailbox agrees with the pieces on the board
+        // meant for asserts
+        [[nodiscard]]
+        constexpr
+        bool mailbox_is_consistent() const;
+
+        // recalculates the piece square score and the phase from the pieces on the board
+        constexpr
+        void update_piece_square();
+
+        // returns true if the piece square score and the phase agree with the pieces on the board
+        // meant for asserts
+        [[nodiscard]]
+        constexpr
+        bool piece_square_is_consistent() const;
+
+        // returns the piece on this square, or no_piece if it is empty
+        [[nodiscard]]
+        constexpr
+        Epiece piece_on(OneSquare sq) const;
+
+        // these functions edit the board and keep the occupation, mailbox and piece square score in sync
+        // when capturing, the captured piece must be removed before the capturing piece moves in
+        constexpr
+        void place_piece(Epiece pc, OneSquare sq);
+
+        constexpr
+        void remove_piece(Epiece pc, OneSquare sq);
+
+        constexpr
+        void move_piece(Epiece pc, OneSquare from, OneSquare to);
+
         // returns true if the King of color col is in check
         template <Color col>
         [[nodiscard]]
@@ -585,6 +798,14 @@ Field get_horse_jumps(OneSquare sq);
 inline
 Field get_king_area(OneSquare sq);
 
+// like get_horse_jumps and get_king_area, but for all squares in f at once
+// the king areas include the squares of f themselves
+constexpr
+Field get_all_horse_jumps(Field f);
+
+constexpr
+Field get_all_king_areas(Field f);
+
 
 
 // returns the piece that is located on field idx
@@ -603,33 +824,10 @@ auto piece_at(const PiecewiseBoard &board, OneSquare point) -> std::optional<Epi
 {
         // assert(bit_count(idx) == 1);
 
-        if (board.rooks<Color::white>() & point) {
-                return white_rooks;
-        } else if (board.queen<Color::white>() & point) {
-                return white_queen;
-        } else if (board.pawns<Color::white>() & point) {
-                return white_pawns;
-        } else if (board.bishops<Color::white>() & point) {
-                return white_bishops;
-        } else if (board.king<Color::white>() & point) {
-                return white_king;
-        } else if (board.horses<Color::white>() & point) {
-                return white_horses;
-        } else if (board.rooks<Color::black>() & point) {
-                return black_rooks;
-        } else if (board.queen<Color::black>() & point) {
-                return black_queen;
-        } else if (board.pawns<Color::black>() & point) {
-                return black_pawns;
-        } else if (board.bishops<Color::black>() & point) {
-                return black_bishops;
-        } else if (board.king<Color::black>() & point) {
-                return black_king;
-        } else if (board.horses<Color::black>() & point) {
-                return black_horses;
-        } else {
+        const Epiece pc = board.piece_on(point);
+        if (pc == no_piece)
                 return std::nullopt;
-        }
+        return pc;
 }
 
 
@@ -733,6 +931,12 @@ auto PiecewiseBoard::operator= (const PiecewiseBoard &other) -> PiecewiseBoard &
 {
         // does not handle self assignment well. Too bad!
         std::copy_n(other.board, 12, board);
+        white_occupation = other.white_occupation;
+        black_occupation = other.black_occupation;
+        total_occupation = other.total_occupation;
+        std::copy_n(other.mailbox, 64, mailbox);
+        piece_square_score = other.piece_square_score;
+        phase = other.phase;
         return *this;
 }
 
@@ -741,6 +945,9 @@ constexpr
 void PiecewiseBoard::to_start()
 {
         std::copy_n(start_board,12, board);
+        update_occupation();
+        update_mailbox();
+        update_piece_square();
 }
 
 template <Color col>
@@ -858,7 +1065,7 @@ template<>
 constexpr
 Field PiecewiseBoard::get_occupation<Color::white>() const
 {
-        return board[0] | board[1] | board[2] | board[3] | board[4] | board[5];
+        return white_occupation;
 }
 
 // returns all squares that contain a black piece
@@ -866,70 +1073,129 @@ template<>
 constexpr
 Field PiecewiseBoard::get_occupation<Color::black>() const
 {
-        return board[6] | board[7] | board[8] | board[9] | board[10] | board[11];
+        return black_occupation;
 }
 
+constexpr
+Field PiecewiseBoard::get_total_occupation() const
+{
+        return total_occupation;
+}
 
-
-template <Color col>
 constexpr
-Field PiecewiseBoard::attack_map() const
+void PiecewiseBoard::update_occupation()
 {
-        const Field friendly_occ = get_occupation<col>();
-        const Field hostile_occ  = get_occupation<!col>();
+        white_occupation = board[0] | board[1] | board[2] | board[3] | board[4] | board[5];
+        black_occupation = board[6] | board[7] | board[8] | board[9] | board[10] | board[11];
+        total_occupation = white_occupation | black_occupation;
+}
 
-        const Field all = friendly_occ | hostile_occ;
+constexpr
+bool PiecewiseBoard::occupation_is_consistent() const
+{
+        PiecewiseBoard recalculated = *this;
+        recalculated.update_occupation();
+        return recalculated.white_occupation == white_occupation
+            && recalculated.black_occupation == black_occupation
+            && recalculated.total_occupation == total_occupation;
+}
 
-        // the returned field that attacked squares will be added onto
-        Field attack = 0;
+constexpr
+void PiecewiseBoard::update_mailbox()
+{
+        std::fill_n(mailbox, 64, no_piece);
+        for (uint8_t pc = white_king; pc <= black_pawns; pc++) {
+                for (Field f = board[pc]; f; f &= f - 1)
+                        mailbox[trailing_0_count(f)] = static_cast<Epiece>(pc);
+        }
+}
 
-        // pawns can attack 1 diagonal to the front, if there are enemies there
-        // pawns can all be done at once
-        // white pawns attack to the TOP, black to the BOTTOM
+constexpr
+bool PiecewiseBoard::mailbox_is_consistent() const
+{
+        PiecewiseBoard recalculated = *this;
+        recalculated.update_mailbox();
+        return std::equal(mailbox, mailbox + 64, recalculated.mailbox);
+}
 
-        if constexpr (col == Color::white) {
-                attack |= shifted<northEast>(pawns<col>());
-                attack |= shifted<northWest>(pawns<col>());
-        } else /* black */ {
-                attack |= shifted<southEast>(pawns<col>());
-                attack |= shifted<southWest>(pawns<col>());
+constexpr
+void PiecewiseBoard::update_piece_square()
+{
+        piece_square_score = 0;
+        phase = 0;
+        for (uint8_t pc = white_king; pc <= black_pawns; pc++) {
+                for (Field f = board[pc]; f; f &= f - 1)
+                        piece_square_score += piece_square_table[pc][trailing_0_count(f)];
+                phase += piece_phase[pc] * bit_count(board[pc]);
         }
+}
 
-        const Field straight_attackers = rooks<col>()   | queen<col>();
-        const Field diagonal_attackers = bishops<col>() | queen<col>();
+constexpr
+bool PiecewiseBoard::piece_square_is_consistent() const
+{
+        PiecewiseBoard recalculated = *this;
+        recalculated.update_piece_square();
+        return recalculated.piece_square_score == piece_square_score && recalculated.phase == phase;
+}
 
-        for (const auto sq : all_squares) {
-                // for efficiency purposes, we continue early if there is no friendly piece there
-                // todo refactor with some continues for more efficiency
-                if (!(sq & friendly_occ))
-                        continue;
+constexpr
+Epiece PiecewiseBoard::piece_on(const OneSquare sq) const
+{
+        return mailbox[square_to_shift(sq)];
+}
 
-                if (sq & straight_attackers) {
-                        attack |= get_weakly_blocked_straights(sq, all);
-                }
-                if (sq & diagonal_attackers) {
-                        attack |= get_weakly_blocked_diagonals(sq, all);
-                } else if (sq & horses<col>()) {
-                        attack |= get_horse_jumps(sq);
-                } else if (sq & king<col>()) {
-                        attack |= get_king_area(sq);
-                }
-        }
+constexpr
+void PiecewiseBoard::place_piece(const Epiece pc, const OneSquare sq)
+{
+        board[pc] |= sq;
+        (get_color(pc) == Color::white ? white_occupation : black_occupation) |= sq;
+        total_occupation |= sq;
+        mailbox[square_to_shift(sq)] = pc;
+        piece_square_score += piece_square_table[pc][square_to_shift(sq)];
+        phase += piece_phase[pc];
+}
+
+constexpr
+void PiecewiseBoard::remove_piece(const Epiece pc, const OneSquare sq)
+{
+        board[pc] &= ~sq;
+        (get_color(pc) == Color::white ? white_occupation : black_occupation) &= ~sq;
+        total_occupation &= ~sq;
+        mailbox[square_to_shift(sq)] = no_piece;
+        piece_square_score -= piece_square_table[pc][square_to_shift(sq)];
+        phase -= piece_phase[pc];
+}
+
+constexpr
+void PiecewiseBoard::move_piece(const Epiece pc, const OneSquare from, const OneSquare to)
+{
+        const Field from_and_to = from | to;
+        board[pc] ^= from_and_to;
+        (get_color(pc) == Color::white ? white_occupation : black_occupation) ^= from_and_to;
+        total_occupation = (total_occupation & ~from) | to;
+        mailbox[square_to_shift(from)] = no_piece;
+        mailbox[square_to_shift(to)] = pc;
+        piece_square_score += piece_square_table[pc][square_to_shift(to)] - piece_square_table[pc][square_to_shift(from)];
+}
+
+
+
+template <Color col, SliderAttacks sa>
+constexpr
+Field PiecewiseBoard::attack_map() const
+{
         // we can not attack our own pieces, so we remove those tiles
-        return attack & ~friendly_occ;
+        return defend_map<col, sa>() & ~get_occupation<col>();
 }
 
 // returns a field type that contains all squares that color col attacks
 // also includes its own pieces that are defended
-template <Color col>
+template <Color col, SliderAttacks sa>
 [[nodiscard, gnu::pure]]
 constexpr
 Field PiecewiseBoard::defend_map() const
 {
-        const Field friendly_occ = get_occupation<col>();
-        const Field hostile_occ  = get_occupation<!col>();
-
-        const Field all = friendly_occ | hostile_occ;
+        const Field all = get_total_occupation();
 
         // the returned field that attacked squares will be added onto
         Field defend = 0;
@@ -946,24 +1212,28 @@ Field PiecewiseBoard::defend_map() const
                 defend |= shifted<southWest>(pawns<col>());
         }
 
-        const Field straight_attackers = rooks<col>()   | queen<col>();
-        const Field diagonal_attackers = bishops<col>() | queen<col>();
-
-        for (const auto sq : all_squares) {
-                if (!(sq & friendly_occ))
-                        continue;
-
-                if (sq & straight_attackers) {
-                        defend |= get_weakly_blocked_straights(sq, all);
-                }
-                if (sq & diagonal_attackers) {
-                        defend |= get_weakly_blocked_diagonals(sq, all);
-                } else if (sq & horses<col>()) {
-                        defend |= get_horse_jumps(sq);
-                } else if (sq & king<col>()) {
-                        defend |= get_king_area(sq);
-                }
+        // horses and the king can be done at once as well
+        defend |= get_all_horse_jumps(horses<col>());
+        defend |= get_all_king_areas(king<col>());
+
+        const Field straight_sliders = rooks<col>()   | queen<col>();
+        const Field diagonal_sliders = bishops<col>() | queen<col>();
+
+        if constexpr (sa == SliderAttacks::kogge_stone) {
+                defend |= get_all_weakly_blocked_straights(straight_sliders, all);
+                defend |= get_all_weakly_blocked_diagonals(diagonal_sliders, all);
+        } else if constexpr (sa == SliderAttacks::kogge_stone_avx2) {
+                defend |= get_all_weakly_blocked_sliders_avx2(straight_sliders, diagonal_sliders, all);
+        } else /* lookup table */ {
+                // the sliders depend on the blockers, so we visit them one by one
+                // a queen is in both loops
+                for (Field f = straight_sliders; f; f &= f - 1)
+                        defend |= get_weakly_blocked_straights(lowest_square(f), all);
+
+                for (Field f = diagonal_sliders; f; f &= f - 1)
+                        defend |= get_weakly_blocked_diagonals(lowest_square(f), all);
         }
+
         return defend;
 }
 
@@ -979,8 +1249,7 @@ bool PiecewiseBoard::in_check() const
         // return king<col>() & attack_map<!col>();
         const OneSquare k = OneSquare_unsafe(king<col>());
         const Field friendly_occ = get_occupation<col>();
-        const Field hostile_occ  = get_occupation<!col>();
-        const Field all = friendly_occ | hostile_occ;
+        const Field all = get_total_occupation();
         const Field weak_straights = get_weakly_blocked_straights(k, all);
         if (weak_straights & (rooks<!col>() | queen<!col>())) {
                 if ((king<col>() & attack_map<!col>()) == false)
@@ -1014,9 +1283,7 @@ bool PiecewiseBoard::in_check() const
 #else
         constexpr bool is_white = col == Color::white;
         const OneSquare k = OneSquare_unsafe(king<col>());
-        const Field friendly_occ = get_occupation<col>();
-        const Field hostile_occ  = get_occupation<!col>();
-        const Field all = friendly_occ | hostile_occ;
+        const Field all = get_total_occupation();
 
         const Field weak_straights = get_weakly_blocked_straights(k, all);
         if (weak_straights & (rooks<!col>() | queen<!col>()))
@@ -1055,6 +1322,16 @@ void PiecewiseBoard::set_all_0(const Field f)
         rooks<col>() &= ~f;
         horses<col>() &= ~f;
         bishops<col>() &= ~f;
+
+        const Field removed = get_occupation<col>() & f;
+        (col == Color::white ? white_occupation : black_occupation) ^= removed;
+        total_occupation ^= removed;
+        for (Field r = removed; r; r &= r - 1) {
+                const int sh = trailing_0_count(r);
+                piece_square_score -= piece_square_table[mailbox[sh]][sh];
+                phase -= piece_phase[mailbox[sh]];
+                mailbox[sh] = no_piece;
+        }
 }
 
 
@@ -1078,7 +1355,7 @@ Position::Position(const Position &other)
 constexpr void
 Position::copy_board(const Position &other) noexcept
 {
-        std::copy_n(other.board, 12, board);
+        PiecewiseBoard::operator=(other);
 }
 
 constexpr
@@ -1137,6 +1414,9 @@ constexpr Position start_position = []() constexpr -> Position {
 constexpr Position empty_position = []() constexpr -> Position {
         Position epwb;
         std::for_each_n(epwb.board, 12, [](Field &f) {f = 0;});
+        epwb.update_occupation();
+        epwb.update_mailbox();
+        epwb.update_piece_square();
         epwb.meta = start_meta; // whatever
         return epwb;
 }();
@@ -1224,19 +1504,25 @@ Field get_horse_jumps(OneSquare sq)
                 const int shift = square_to_shift(sq);
                 return horse_jumps_table[shift];
         } else {
-                Field ret = 0;
-                ret |= sq << 15 & msk::RIGHT;   // nnw
-                ret |= sq << 17 & msk::LEFT;    // nne
-                ret |= sq << 10 & msk::LEFT2;   // nee
-                ret |= sq << 6  & msk::RIGHT2;  // nww
-                ret |= sq >> 15 & msk::LEFT;    // sse
-                ret |= sq >> 17 & msk::RIGHT;   // ssw
-                ret |= sq >> 10 & msk::RIGHT2;  // sww
-                ret |= sq >> 6  & msk::LEFT2;   // see
-                return ret;
+                return get_all_horse_jumps(sq);
         }
 }
 
+constexpr
+Field get_all_horse_jumps(const Field f)
+{
+        Field ret = 0;
+        ret |= f << 15 & msk::RIGHT;   // nnw
+        ret |= f << 17 & msk::LEFT;    // nne
+        ret |= f << 10 & msk::LEFT2;   // nee
+        ret |= f << 6  & msk::RIGHT2;  // nww
+        ret |= f >> 15 & msk::LEFT;    // sse
+        ret |= f >> 17 & msk::RIGHT;   // ssw
+        ret |= f >> 10 & msk::RIGHT2;  // sww
+        ret |= f >> 6  & msk::LEFT2;   // see
+        return ret;
+}
+
 
 
 extern const std::array<Field, 64> king_area_lookup_table;
@@ -1248,22 +1534,28 @@ Field get_king_area(OneSquare sq)
                 const int shift = square_to_shift(sq);
                 return king_area_lookup_table[shift];
         } else {
-                // the surrounding points are projected onto the "grid"
+                return get_all_king_areas(sq);
+        }
+}
 
-                Field area = sq;
+constexpr
+Field get_all_king_areas(const Field f)
+{
+        // the surrounding points are projected onto the "grid"
 
-                area |= shifted<north>(area);
-                area |= shifted<south>(area);
+        Field area = f;
 
-                //                      0 1 0
-                // area looks like      0 1 0   (unless edge)
-                //                      0 1 0
+        area |= shifted<north>(area);
+        area |= shifted<south>(area);
 
+        //                      0 1 0
+        // area looks like      0 1 0   (unless edge)
+        //                      0 1 0
 
-                area |= shifted<east>(area);
-                area |= shifted<west>(area);
-                return area;
-        }
+
+        area |= shifted<east>(area);
+        area |= shifted<west>(area);
+        return area;
 }
 
 
@@ -0,0 +1,68 @@
+//
+// Created by Hugo Bogaart on 18/10/2026.
+//
+
+#ifndef PV_TABLE_H
+#define PV_TABLE_H
+
+#include "position.h"
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <vector>
+
+// the principal variation of every node in the current line, one table for each thread
+//
+// row ply holds the best line found from the node at that ply, and it is made of
+// the best move there and the row of ply + 1 right after that move was searched
+// so the rows get shorter further away from the root, hence triangular
+class PvTable {
+
+        static constexpr size_t max_ply = 128;
+
+        std::array<std::array<Move, max_ply>, max_ply> moves;
+        std::array<size_t, max_ply> lengths = {};
+
+public:
+        // the pv of the last finished iteration
+        // the nodes along it try its move first in the next iteration
+        std::vector<Move> previous;
+
+        // the number of moves at the start of the current line that are those of previous
+        size_t matching = 0;
+
+        // every node starts without a line, it keeps none if it returns early
+        auto clear (size_t ply) -> void
+        {
+                if (ply < max_ply)
+                        lengths[ply] = 0;
+        }
+
+        // mv is the new best move at ply, and the child has just filled its row
+        auto update (size_t ply, Move mv) -> void
+        {
+                if (ply >= max_ply)
+                        return;
+                moves[ply][0] = mv;
+                lengths[ply] = 1;
+                if (ply + 1 < max_ply) {
+                        std::copy_n(moves[ply + 1].begin(), lengths[ply + 1], moves[ply].begin() + 1);
+                        lengths[ply] += lengths[ply + 1];
+                }
+        }
+
+        // the move of the previous pv at this node, if the line so far is that pv too
+        auto previous_move (size_t ply) const -> std::optional<Move>
+        {
+                if (matching == ply && ply < previous.size())
+                        return previous[ply];
+                return std::nullopt;
+        }
+
+        auto line () const -> std::vector<Move>
+        {
+                return {moves[0].begin(), moves[0].begin() + lengths[0]};
+        }
+};
+
+#endif //PV_TABLE_H
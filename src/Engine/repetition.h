@@ -0,0 +1,116 @@
+//
+// Created by Hugo Bogaart on 18/10/2026.
+//
+
+#ifndef REPETITION_H
+#define REPETITION_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// the hashes of the positions played on the board, followed by those of the line that is being searched
+// one for each thread, push when entering a node and pop when leaving it
+//
+// a position can only repeat since the last capture or pawn move, and only with the same side to move,
+// so a lookup only goes back passive_move_counter plies, two at a time
+class RepetitionHistory {
+
+        // the search line plus 255 passive moves fit with plenty of room
+        static constexpr size_t capacity = 1024;
+        static constexpr size_t filter_size = 1024;
+
+        std::array<uint64_t, capacity> hashes;
+
+        // the number of positions in the buffer with some low bits of the hash
+        // if it is 0, the position can not be a repetition, without looking at the hashes
+        std::array<uint16_t, filter_size> filter = {};
+
+        size_t size = 0;        // the index of the next position, the first ones may be overwritten
+        size_t oldest = 0;      // the index of the first position that is still in the buffer
+        size_t root = 0;        // the index of the root of the search
+
+        static auto slot (size_t idx) -> size_t {return idx % capacity;}
+        static auto filter_slot (uint64_t hash) -> size_t {return (hash >> 1) % filter_size;} // the last bit is the color
+
+public:
+        struct Repetitions {
+                int on_board = 0;       // the number of times it has been played before the root
+                int in_line = 0;        // the number of times it is in the searched line, the root included
+        };
+
+        // the positions on the board before the root, in the order they were played
+        auto reset (const std::vector<uint64_t> &played_hashes) -> void
+        {
+                size = oldest = 0;
+                filter.fill(0);
+                for (const uint64_t hash : played_hashes)
+                        push(hash);
+                root = size;
+        }
+
+        auto push (uint64_t hash) -> void
+        {
+                if (size - oldest == capacity) {
+                        filter[filter_slot(hashes[slot(oldest)])]--;
+                        oldest++;
+                }
+                hashes[slot(size)] = hash;
+                filter[filter_slot(hash)]++;
+                size++;
+        }
+
+        auto pop () -> void
+        {
+                assert(size > root);
+                size--;
+                // it may have been overwritten already, and then it is no longer counted
+                if (size >= oldest)
+                        filter[filter_slot(hashes[slot(size)])]--;
+                else
+                        oldest = size;
+        }
+
+        // the number of positions in the searched line, so the ply of the next one
+        auto line_length () const -> size_t {return size - root;}
+
+        // how many times the position with this hash is in the history, it is not pushed itself yet
+        auto count (uint64_t hash, unsigned passive_move_counter) const -> Repetitions
+        {
+                Repetitions reps;
+                if (filter[filter_slot(hash)] == 0)
+                        return reps;
+
+                const size_t available = size - oldest;
+                const size_t max_back = std::min<size_t>(passive_move_counter, available);
+                for (size_t back = 2; back <= max_back; back += 2) {
+                        const size_t idx = size - back;
+                        if (hashes[slot(idx)] == hash) {
+                                if (idx >= root)
+                                        reps.in_line++;
+                                else
+                                        reps.on_board++;
+                        }
+                }
+                return reps;
+        }
+
+        // pushes on construction and pops on destruction
+        struct Guard {
+                Guard (RepetitionHistory &history, uint64_t hash)
+                        : history(history)
+                {
+                        history.push(hash);
+                }
+                ~Guard ()
+                {
+                        history.pop();
+                }
+                Guard (const Guard &) = delete;
+                RepetitionHistory &history;
+        };
+};
+
+#endif //REPETITION_H
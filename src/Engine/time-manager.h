@@ -0,0 +1,95 @@
+//
+// Created by Hugo Bogaart on 18/10/2026.
+//
+
+#ifndef TIME_MANAGER_H
+#define TIME_MANAGER_H
+
+#include "eval.h"
+#include "position.h"
+#include <algorithm>
+#include <chrono>
+#include <optional>
+
+// decides how long to think about a move from the clock of the side to move
+//
+// the soft limit is the time that is normally spent on a move, the hard limit is the time it never exceeds
+// the search only stops between iterations by itself, when the next one is not worth starting:
+// - the soft limit is reached, it is stretched if the best move keeps changing or the score drops
+// - the next iteration is predicted to end after the hard limit, so it would be thrown away
+// - there is only one legal move, or the result is a forced mate
+class TimeManager {
+public:
+        typedef std::chrono::duration<double, std::milli> Millis;
+
+        // the time for the gui and the communication, that the clock loses on every move
+        static constexpr Millis move_overhead{10};
+
+        // the number of moves the remaining time is spread over, if the gui does not say
+        static constexpr size_t default_moves_to_go = 30;
+
+        TimeManager (Millis time_left, Millis increment, std::optional<size_t> moves_to_go, size_t num_root_moves)
+                : num_root_moves(num_root_moves)
+        {
+                const Millis available = std::max(time_left - move_overhead, Millis(1));
+                const size_t moves = std::clamp<size_t>(moves_to_go.value_or(default_moves_to_go), 1, default_moves_to_go);
+
+                // most of the increment is used, since it comes back after the move
+                soft = std::min(available / moves + increment * 0.75, available * 0.6);
+                hard = std::min(soft * 3, available * 0.8);
+        }
+
+        auto soft_limit () const -> Millis {return soft;}
+        auto hard_limit () const -> Millis {return hard;}
+
+        // an iteration has finished at "elapsed" since the start of the search,
+        // with the best move and the score from the side to move
+        // returns whether the search should stop instead of starting the next iteration
+        auto should_stop (Move best_move, Eval score, Millis elapsed) -> bool
+        {
+                const Millis iteration = elapsed - last_elapsed;
+                const bool first = iterations++ == 0;
+
+                // a best move that changed recently counts more than one that changed long ago
+                instability *= 0.5;
+                if (!first && best_move != last_best_move)
+                        instability += 1.0;
+                double factor = 1.0 + instability;
+
+                // a falling score needs time to find a way out
+                const Eval capped = std::clamp<Eval>(score, -1000, 1000);
+                const Eval drop = first ? 0 : last_score - capped;
+                if (drop > 20)
+                        factor *= 1.0 + std::min<Eval>(drop, 200) / 400.0;
+
+                // the next iteration costs about this one times the growth from the one before
+                const double branching = !first && prev_iteration.count() > 0
+                        ? std::clamp(iteration / prev_iteration, 1.5, 6.0)
+                        : 4.0;
+
+                last_best_move = best_move;
+                last_score = capped;
+                last_elapsed = elapsed;
+                prev_iteration = iteration;
+
+                if (num_root_moves == 1 || is_mate(score))
+                        return true;
+
+                const Millis target = std::min(soft * factor, hard);
+                return elapsed >= target || elapsed + iteration * branching > hard;
+        }
+
+private:
+        Millis soft;
+        Millis hard;
+        size_t num_root_moves;
+
+        size_t iterations = 0;
+        double instability = 0.0;
+        Move last_best_move{};
+        Eval last_score = 0;
+        Millis last_elapsed{0};
+        Millis prev_iteration{0};
+};
+
+#endif //TIME_MANAGER_H
@@ -8,6 +8,7 @@
 #include <cstdint>
 #include "position.h"
 #include "memory"
+#include <utility>
 #include <array>
 #include "eval.h"
 
@@ -93,18 +93,38 @@ namespace HashConstants
 constexpr
 auto zobrist_hash(const Position &pos) -> uint64_t;
 
+// the hash of only the pawns, with the same keys as the full hash
+// for tables that only care about the pawn structure
+constexpr
+auto pawn_zobrist_hash(const Position &pos) -> uint64_t;
+
 struct PositionHashPair {
 
         PositionHashPair() = default;
         PositionHashPair (const Position &position, uint64_t zhash)
                 : pos(position),
-                  hash(zhash)
+                  hash(zhash),
+                  pawn_hash(pawn_zobrist_hash(position))
         { }
 
         Position pos;
         uint64_t hash;  // associated hash pair;
+        uint64_t pawn_hash; // kept up to date by make_move_unsafe as well
 };
 
+constexpr
+auto pawn_zobrist_hash(const Position &pos) -> uint64_t
+{
+        using namespace HashConstants;
+
+        uint64_t hash = 0ull;
+        for (const Epiece pc : {white_pawns, black_pawns}) {
+                for (Field f = pos.piece_field(pc); f; f &= f - 1)
+                        hash ^= piece_square_hash(pc, trailing_0_count(f));
+        }
+        return hash;
+}
+
 
 
 constexpr
@@ -115,18 +135,11 @@ auto zobrist_hash(const Position &pos) -> uint64_t
         uint64_t hash = 0ull;
         // we just xor all the properties
 
-        // all pieces (64 squares * 12 pieces)
-        // technically we can have less for the pawns. Too bad!
-
+        // all pieces, only the squares where there is one
         for (int piece = 0; piece < 12; piece++) {
                 const auto pc = static_cast<Epiece>(piece);
-                Field f = pos.piece_field(pc);
-                for (int sq = 0; sq < 64; sq++) {
-                        if (f & square_from_shift(sq)) {
-                                // there is a Piece of value piece at Square sq
-                                hash ^= piece_square_hash(pc, sq);
-                        }
-                }
+                for (Field f = pos.piece_field(pc); f; f &= f - 1)
+                        hash ^= piece_square_hash(pc, trailing_0_count(f));
         }
 
         if (pos.meta.active == Color::black)
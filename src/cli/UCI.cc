@@ -7,10 +7,14 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <algorithm>
+#include <chrono>
 
 #include "cli-utils.h"
+#include "bench.h"
 #include "../Engine/engine.h"
 #include "../Engine/position.h"
+#include "../Engine/perft.h"
 
 struct UCIState {
         bool debug = false;
@@ -39,6 +43,9 @@ auto get_line() -> std::string
 // CHOOSE to only use names without comma, because they are stupid
 constexpr auto options = "option name Hash type spin default 1 min 1 max 4096\n"
                          "option name Clear-Hash type button\n"
+                         "option name Use-NNUE type check default false\n"
+                         "option name NNUE-File type string default <empty>\n"
+                         "option name MultiPV type spin default 1 min 1 max 256\n"
 // no ponder yet         "option name Ponder type check\n"
                                                                         ;
 
@@ -229,6 +236,8 @@ auto uci () -> void
                 std::cout << "info ";
                 if (args.depth)
                         std::cout << "depth " << *args.depth << " ";
+                if (args.multipv)
+                        std::cout << "multipv " << *args.multipv << " ";
                 if (args.time_ms)
                         std::cout << "time " << *args.time_ms << " ";
                 if (args.nodes)
@@ -255,11 +264,18 @@ auto uci () -> void
 
                 // pv last
                 if (args.pv) {
+                        // the colors take turns along the line
                         std::cout << "pv";
+                        Color mover = col;
                         for (const Move mv : *args.pv) {
-                                std::cout << ' ' << toAlgebraic(mv, col);
+                                std::cout << ' ' << toAlgebraic(mv, mover);
+                                mover = !mover;
                         }
+                        std::cout << ' ';
                 }
+                // except for the string, which takes the rest of the line
+                if (args.string)
+                        std::cout << "string " << *args.string;
                 std::cout << "\n" << std::flush;
         };
 
@@ -288,6 +304,9 @@ auto uci () -> void
                         "quit",
                         "ping",  // custom
                         "d",    // custom "display board"
+                        "perft",  // custom "perft <depth> [threads]"
+                        "divide", // custom "divide <depth>", perft per root move
+                        "bench",  // custom "bench [depth] [threads] [hash]"
                         "mkay"
                 };
 
@@ -314,6 +333,7 @@ auto uci () -> void
                                         state.debug = true;
                                 else
                                         state.debug = false;
+                                engine.options().debug = state.debug;
                         } else {
                                 std::cerr << "invalid debug mode: \"" << merge_strings(parser.rest()) << "\"\n";
                         }
@@ -342,6 +362,27 @@ auto uci () -> void
                                         engine.resize_hashtable(TransTable::MegaByte(*new_size_mb));
                                         state.tt_size = TransTable::MegaByte(*new_size_mb);
                                 }
+                        } else if (option_name && *option_name == "Use-NNUE") {
+                                // without a network, the classical eval is used anyway
+                                const std::optional<std::string> option_value = parser.find_after("value").first_word();
+                                engine.options().use_nnue = option_value == "true";
+
+                        } else if (option_name && *option_name == "NNUE-File") {
+                                // the path may have spaces
+                                const UCIParser value_parser = parser.find_after("value");
+                                const std::string path = value_parser ? merge_strings(value_parser.rest()) : "";
+                                if (path.empty() || path == "<empty>") {
+                                        engine.set_network(nullptr);
+                                } else if (std::unique_ptr<Nnue::Network> net = Nnue::load_network(path)) {
+                                        engine.set_network(std::move(net));
+                                } else {
+                                        std::cerr << "could not load network \"" << path << "\"\n";
+                                }
+                        } else if (option_name && *option_name == "MultiPV") {
+                                const std::optional<std::string> option_value = parser.find_after("value").first_word();
+                                const std::optional<uint64_t> num_lines = option_value ? str_to_uint(*option_value) : std::nullopt;
+                                if (num_lines && *num_lines >= 1)
+                                        engine.options().multi_pv = std::min<size_t>(*num_lines, maxMoves);
                         } // else if (option_name && *option_name == "Clear-Hash")
 
                         else {
@@ -383,10 +424,12 @@ auto uci () -> void
                                 if (!pos) {
                                         std::cerr << "invalid position given " << pos_strs[0] << '\n';
                                 }
-                        } else if (pos_strs.size() == 2 && pos_strs[0] == "fen") {
-                                pos = fromFen(pos_strs[1]);
+                        } else if (pos_strs.size() >= 2 && pos_strs[0] == "fen") {
+                                // the fen itself has spaces, so it is every word up to "moves"
+                                const std::string fen = merge_strings({pos_strs.begin() + 1, pos_strs.end()});
+                                pos = fromFen(fen);
                                 if (!pos) {
-                                        std::cerr << "invalid position given " << pos_strs[1] << '\n';
+                                        std::cerr << "invalid position given " << fen << '\n';
                                 }
                         } else {
                                 std::cerr << "no position given\n";
@@ -555,6 +598,53 @@ auto uci () -> void
                 } else if (word == "d") {
                         std::cout << board2str(engine.get_position()) << "\n"
                                   << "Hash " << std::hex << zobrist_hash(engine.get_position()) << std::dec << std::endl;
+                } else if (word == "perft" || word == "divide") {
+                        std::optional<std::string> depth_str = parser.first_word();
+                        std::optional<uint64_t> depth = std::nullopt;
+                        if (depth_str)
+                                depth = str_to_uint(*depth_str);
+                        if (!depth) {
+                                std::cerr << "no depth given for " << word << "\n";
+                                continue;
+                        }
+
+                        // perft may be given a number of threads after the depth
+                        // it then shares a table as big as the hash
+                        std::optional<std::string> threads_str = parser.find_after(*depth_str).first_word();
+                        size_t num_threads = 1;
+                        if (threads_str)
+                                num_threads = str_to_uint(*threads_str).value_or(1);
+
+                        const Position &pos = engine.get_position();
+                        size_t nodes = 0;
+                        double time_s;
+                        {
+                                Timer<double, std::chrono::seconds> _(time_s);
+                                if (word == "divide") {
+                                        for (const auto &[mv, count] : divide(pos, static_cast<int>(*depth))) {
+                                                std::cout << toAlgebraic(mv, pos.meta.active) << ": " << count << "\n";
+                                                nodes += count;
+                                        }
+                                        std::cout << "\n";
+                                } else if (num_threads > 1) {
+                                        PerftTable table(state.tt_size.num_mbs);
+                                        nodes = parallel_perft(pos, static_cast<int>(*depth), num_threads, &table);
+                                } else {
+                                        nodes = perft(pos, static_cast<int>(*depth));
+                                }
+                        }
+                        const auto time_ms = static_cast<uint64_t>(time_s * 1000);
+                        const auto nps = static_cast<uint64_t>(static_cast<double>(nodes) / std::max(time_s, 1e-9));
+                        std::cout << "nodes " << nodes << " time " << time_ms << " nps " << nps << "\n";
+                } else if (word == "bench") {
+                        // all arguments are optional, but in this order
+                        const std::vector<std::string> args = parser.rest();
+                        auto arg = [&](size_t i, size_t default_value) -> size_t {
+                                if (i < args.size())
+                                        return str_to_uint(args[i]).value_or(default_value);
+                                return default_value;
+                        };
+                        bench(static_cast<int>(arg(0, 5)), arg(1, 1), arg(2, 16));
                 } else if (word == "mkay") {
                         std::cout << "drugs are bad mkay\n";
                 } else {
@@ -0,0 +1,15 @@
+//
+// Created by Hugo Bogaart on 18/10/2026.
+//
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstddef>
+
+// searches a fixed set of positions to a fixed depth and prints the total nodes and nps
+// with one thread the node count is a signature of the search: any functional change shows up in it
+// more threads search different positions at the same time, each with their own table
+auto bench (int depth = 5, size_t num_threads = 1, size_t hash_mb = 16) -> void;
+
+#endif //BENCH_H
@@ -84,6 +84,7 @@ auto epiece_to_char (const Epiece pc) noexcept -> char
         case black_rooks:       return 'r';
         case black_queen:       return 'q';
         case black_king:        return 'k';
+        case no_piece:          return ' ';
         }
 }
 
@@ -223,7 +224,7 @@ auto fromFen (const std::string &fen) noexcept -> std::optional<Position>
                 if (optpc.has_value()) {
                         // add piece to the board
                         const OneSquare sq = OneSquare(rank, file);
-                        board.piece_field(optpc.value()) |= sq;
+                        board.place_piece(optpc.value(), sq);
                 }
                 file++;
         }
@@ -1,7 +1,8 @@
 #include <iostream>
 #include <string>
-#include "../unit-tests/unit-tests.h"
 #include "cli/UCI.h"
+#include "cli/bench.h"
+#include "cli/cli-utils.h"
 
 #include <fstream>
 
@@ -50,7 +51,20 @@ int main(int argc, char **argv)
 {
 
         // Redirect redirect("engine_error_output.txt");
-        run_tests();
+
+        // the unit tests are their own executable now, the engine starts straight into uci
+
+        // "bench [depth] [threads] [hash]" on the command line benches and exits
+        if (argc > 1 && std::string(argv[1]) == "bench") {
+                auto arg = [&](int i, size_t default_value) -> size_t {
+                        if (i < argc)
+                                return str_to_uint(argv[i]).value_or(default_value);
+                        return default_value;
+                };
+                bench(static_cast<int>(arg(2, 5)), arg(3, 1), arg(4, 16));
+                return EXIT_SUCCESS;
+        }
+
         bot();
         return EXIT_SUCCESS;
 }
\ No newline at end of file
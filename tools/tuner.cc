@@ -0,0 +1,446 @@
+//
+// Created by Hugo Bogaart on 18/10/2026.
+//
+
+// texel tuning of the constants in eval-params.h
+// the eval is linear in these constants, so every position is turned into the coefficient of each constant once
+// then gradient descent minimizes the squared error between the result of the game and a sigmoid of the eval
+//
+// usage: tuner <positions file> [output header = eval-params.h] [iterations = 1000] [threads]
+// every line of the positions file is a fen followed by the result of the game for white:
+// 1-0, 0-1, 1/2-1/2, or a number like [1.0], [0.5] or 0.0
+
+#include "../src/Engine/position.h"
+#include "../src/Engine/eval.h"
+#include "../src/cli/cli-utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// which phase a constant counts in, like the halves of a PackedScore
+enum class Taper : uint8_t {
+        both, mg, eg
+};
+
+// a constant of eval-params.h, or an array of them
+struct Constant {
+        const char *name;
+        const char *group;      // the comment above it in the header, if it starts a group
+        Taper taper;
+        std::vector<int> values;
+};
+
+template <size_t N>
+auto values_of (const int (&arr)[N]) -> std::vector<int> {return {arr, arr + N};}
+
+// in the same order as eval-params.h
+const std::vector<Constant> constants = {
+        {"queen_val", "// material", Taper::both, {queen_val}},
+        {"rook_val", nullptr, Taper::both, {rook_val}},
+        {"bishop_val", nullptr, Taper::both, {bishop_val}},
+        {"horse_val", nullptr, Taper::both, {horse_val}},
+        {"pawn_val", nullptr, Taper::mg, {pawn_val}},
+        {"pawn_val_eg", nullptr, Taper::eg, {pawn_val_eg}},
+
+        {"king_safety_lastrank_val", "// one piece on its square, _eg terms count in the endgame, the others in the midgame\n"
+                                     "// rings are msk::ring, from the edge inwards, and advanced pawns are on the 6th and 7th rank",
+                Taper::mg, {king_safety_lastrank_val}},
+        {"king_safety_2ndlastrank_val", nullptr, Taper::mg, {king_safety_2ndlastrank_val}},
+        {"king_ring_eg", nullptr, Taper::eg, values_of(king_ring_eg)},
+        {"horse_ring_mg", nullptr, Taper::mg, values_of(horse_ring_mg)},
+        {"horse_ring_eg", nullptr, Taper::eg, values_of(horse_ring_eg)},
+        {"pawn_center_val", nullptr, Taper::mg, {pawn_center_val}},
+        {"rook_file_pawn_penalty", nullptr, Taper::mg, {rook_file_pawn_penalty}},
+        {"pawn_advanced_mg", nullptr, Taper::mg, values_of(pawn_advanced_mg)},
+        {"pawn_advanced_eg", nullptr, Taper::eg, values_of(pawn_advanced_eg)},
+
+        {"bishop_pair_bonus", "// activity and attacks", Taper::both, {bishop_pair_bonus}},
+        {"par_square_attack_score", nullptr, Taper::both, {par_square_attack_score}},
+        {"queen_attack_val", nullptr, Taper::both, {queen_attack_val}},
+        {"rook_attack_val", nullptr, Taper::both, {rook_attack_val}},
+        {"bishop_attack_val", nullptr, Taper::both, {bishop_attack_val}},
+        {"horse_attack_val", nullptr, Taper::both, {horse_attack_val}},
+        {"pawn_attack_val", nullptr, Taper::both, {pawn_attack_val}},
+        {"pawn_delta_attack_val", nullptr, Taper::both, {pawn_delta_attack_val}},
+        {"horse_pawn_bonus", nullptr, Taper::both, {horse_pawn_bonus}},
+        {"bishop_pawn_penalty", nullptr, Taper::both, {bishop_pawn_penalty}},
+        {"unblocked_rook_score", nullptr, Taper::both, {unblocked_rook_score}},
+        {"king_open_area_penalty", nullptr, Taper::both, {king_open_area_penalty}},
+        {"attack_other_king_val", nullptr, Taper::both, {attack_other_king_val}},
+
+        {"double_pawn_penalty", "// pawn structure", Taper::both, {double_pawn_penalty}},
+        {"pawn_chain_defense_bonus", nullptr, Taper::both, {pawn_chain_defense_bonus}},
+};
+
+// the index of an element of a constant in the flat parameter vector
+auto param_index (const std::string &name, size_t i = 0) -> size_t
+{
+        static const std::unordered_map<std::string, size_t> offsets = [] {
+                std::unordered_map<std::string, size_t> map;
+                size_t idx = 0;
+                for (const Constant &c : constants) {
+                        map[c.name] = idx;
+                        idx += c.values.size();
+                }
+                return map;
+        }();
+        return offsets.at(name) + i;
+}
+
+// the parameters as they are now in eval-params.h, and the phase each counts in
+const std::vector<double> initial_params = [] {
+        std::vector<double> params;
+        for (const Constant &c : constants)
+                params.insert(params.end(), c.values.begin(), c.values.end());
+        return params;
+}();
+
+const std::vector<Taper> param_tapers = [] {
+        std::vector<Taper> tapers;
+        for (const Constant &c : constants)
+                tapers.insert(tapers.end(), c.values.size(), c.taper);
+        return tapers;
+}();
+
+const size_t num_params = initial_params.size();
+
+// a position as the coefficients of the parameters, white minus black
+struct Sample {
+        std::vector<int16_t> coefficients;
+        float mg_fraction;      // tapered(mg, eg) = mg_fraction * mg + (1 - mg_fraction) * eg
+        float result;
+};
+
+// adds the coefficients of the side col, mirroring eval_col, pawn_structure_col and piece_square_value
+template <Color col>
+auto add_coefficients (const Position &board, int sign, std::vector<int16_t> &coefficients) -> void
+{
+        constexpr bool is_white = col == Color::white;
+        auto add = [&](const char *name, int amount, size_t i = 0) {
+                coefficients[param_index(name, i)] += static_cast<int16_t>(sign * amount);
+        };
+
+        const Field atm = board.attack_map<col>();
+        const Field all_friendly = board.get_occupation<col>();
+
+        const Field &queens  = board.queen<col>(),
+                    &pawns   = board.pawns<col>(),
+                    &rooks   = board.rooks<col>(),
+                    &horses  = board.horses<col>(),
+                    &bishops = board.bishops<col>(),
+                    &king    = board.king<col>();
+
+        const Field &enemy_queens  = board.queen<!col>(),
+                    &enemy_pawns   = board.pawns<!col>(),
+                    &enemy_rooks   = board.rooks<!col>(),
+                    &enemy_horses  = board.horses<!col>(),
+                    &enemy_bishops = board.bishops<!col>(),
+                    &enemy_king    = board.king<!col>();
+
+        auto rel_rank = [](int r) -> Field {
+                return is_white ? msk::rank[r] : msk::rank[7 - r];
+        };
+
+        // material and one piece on its square
+        add("queen_val", bit_count(queens));
+        add("rook_val", bit_count(rooks));
+        add("bishop_val", bit_count(bishops));
+        add("horse_val", bit_count(horses));
+        add("pawn_val", bit_count(pawns));
+        add("pawn_val_eg", bit_count(pawns));
+
+        add("king_safety_lastrank_val", bit_count(king & (msk::rank[0] | msk::rank[7])) + bit_count(king & (msk::file[0] | msk::file[7])));
+        add("king_safety_2ndlastrank_val", bit_count(king & (msk::rank[1] | msk::rank[6])) + bit_count(king & (msk::file[1] | msk::file[6])));
+        for (size_t r = 0; r < 4; r++) {
+                add("king_ring_eg", bit_count(king & msk::ring[r]), r);
+                add("horse_ring_mg", bit_count(horses & msk::ring[r]), r);
+                add("horse_ring_eg", bit_count(horses & msk::ring[r]), r);
+        }
+        add("pawn_center_val", bit_count(pawns & ~msk::file[0] & ~msk::file[7]));
+        add("rook_file_pawn_penalty", -bit_count(pawns & (msk::file[0] | msk::file[7])));
+        for (size_t i = 0; i < 2; i++) {
+                add("pawn_advanced_mg", bit_count(pawns & rel_rank(5 + i)), i);
+                add("pawn_advanced_eg", bit_count(pawns & rel_rank(5 + i)), i);
+        }
+
+        // activity and attacks
+        add("bishop_pair_bonus", (bishops & msk::white_squares) && (bishops & msk::black_squares));
+        add("par_square_attack_score", bit_count(atm));
+        add("queen_attack_val", bit_count(atm & enemy_queens));
+        add("rook_attack_val", bit_count(atm & enemy_rooks));
+        add("bishop_attack_val", bit_count(atm & enemy_bishops));
+        add("horse_attack_val", bit_count(atm & enemy_horses));
+        add("pawn_attack_val", bit_count(atm & enemy_pawns));
+
+        // the eval scales this by the material, which is kept at its current value here
+        // so the eval stays linear in the parameters
+        const Field pawns_east_attack = is_white ? shifted<northEast>(pawns) : shifted<southEast>(pawns);
+        const Field pawns_west_attack = is_white ? shifted<northWest>(pawns) : shifted<southWest>(pawns);
+        auto pawn_attacks = [&](Field enemies) {
+                return bit_count(pawns_east_attack & enemies) + bit_count(pawns_west_attack & enemies);
+        };
+        add("pawn_delta_attack_val", (rook_val - 100) / 100 * pawn_attacks(enemy_rooks)
+                                   + (queen_val - 100) / 100 * pawn_attacks(enemy_queens)
+                                   + (horse_val - 100) / 100 * pawn_attacks(enemy_horses)
+                                   + (bishop_val - 100) / 100 * pawn_attacks(enemy_bishops));
+
+        add("horse_pawn_bonus", bit_count(horses) * bit_count(pawns | enemy_pawns));
+        add("bishop_pawn_penalty", -bit_count(bishops) * bit_count(pawns | enemy_pawns));
+        add("unblocked_rook_score", bit_count(occupied_files(rooks) & static_cast<uint8_t>(~occupied_files(pawns))));
+        add("king_open_area_penalty", -bit_count(get_king_area(OneSquare_unsafe(king)) & ~all_friendly));
+        add("attack_other_king_val", (atm & enemy_king) != 0);
+
+        // pawn structure
+        int num_double_pawns = 0;
+        for (Field file = msk::file[0]; file; shift<east>(file))
+                num_double_pawns += std::max(bit_count(pawns & file) - 1, 0);
+        add("double_pawn_penalty", -num_double_pawns);
+        add("pawn_chain_defense_bonus", bit_count(pawns_east_attack & pawns) + bit_count(pawns_west_attack & pawns));
+}
+
+// the eval of a sample with these parameters, like static_eval without the rounding
+auto linear_eval (const Sample &sample, const std::vector<double> &params) -> double
+{
+        double mg = 0, eg = 0, both = 0;
+        for (size_t i = 0; i < num_params; i++) {
+                const double term = params[i] * sample.coefficients[i];
+                (param_tapers[i] == Taper::mg ? mg : param_tapers[i] == Taper::eg ? eg : both) += term;
+        }
+        return both + sample.mg_fraction * mg + (1 - sample.mg_fraction) * eg;
+}
+
+auto make_sample (const Position &pos, float result) -> Sample
+{
+        Sample sample{std::vector<int16_t>(num_params, 0), 0, result};
+        add_coefficients<Color::white>(pos, 1, sample.coefficients);
+        add_coefficients<Color::black>(pos, -1, sample.coefficients);
+        sample.mg_fraction = static_cast<float>(std::min<int>(pos.phase, max_phase)) / max_phase;
+        return sample;
+}
+
+// the result of the game for white, somewhere after the fen
+auto parse_result (const std::string &rest) -> std::optional<float>
+{
+        if (rest.find("1/2-1/2") != std::string::npos)
+                return 0.5f;
+        if (rest.find("1-0") != std::string::npos)
+                return 1.0f;
+        if (rest.find("0-1") != std::string::npos)
+                return 0.0f;
+
+        // the first number, maybe within brackets or quotes
+        std::string cleaned = rest;
+        std::ranges::replace_if(cleaned, [](char c) {return c == '[' || c == ']' || c == '"' || c == ';';}, ' ');
+        std::istringstream stream(cleaned);
+        float result;
+        if (stream >> result && result >= 0 && result <= 1)
+                return result;
+        return std::nullopt;
+}
+
+auto load_samples (const std::string &path) -> std::vector<Sample>
+{
+        std::ifstream file(path);
+        if (!file) {
+                std::cerr << "could not open " << path << '\n';
+                std::exit(EXIT_FAILURE);
+        }
+
+        std::vector<Sample> samples;
+        size_t num_skipped = 0;
+        double max_difference = 0;
+        for (std::string line; std::getline(file, line);) {
+                // board, color, castling and en passant, and maybe the move counters
+                std::istringstream stream(line);
+                std::vector<std::string> words;
+                for (std::string word; words.size() < 6 && stream >> word;)
+                        words.push_back(word);
+                size_t fen_words = std::min<size_t>(words.size(), 4);
+                while (fen_words < words.size() && std::ranges::all_of(words[fen_words], ::isdigit))
+                        fen_words++;
+
+                std::string fen;
+                for (size_t i = 0; i < fen_words; i++)
+                        fen += (i ? " " : "") + words[i];
+                std::string rest;
+                for (size_t i = fen_words; i < words.size(); i++)
+                        rest += words[i] + ' ';
+                std::getline(stream, line);
+                rest += line;
+
+                const std::optional<Position> pos = fromFen(fen);
+                const std::optional<float> result = parse_result(rest);
+                if (!pos || !result) {
+                        num_skipped++;
+                        continue;
+                }
+                samples.push_back(make_sample(*pos, *result));
+                max_difference = std::max(max_difference, std::abs(static_eval(*pos) - linear_eval(samples.back(), initial_params)));
+        }
+        std::cout << "loaded " << samples.size() << " positions, skipped " << num_skipped << " lines\n";
+
+        // the coefficients should give the real eval, up to the rounding of the taper
+        // if not, the tuner no longer mirrors the eval
+        std::cout << "largest difference with static_eval " << max_difference << " cp\n";
+        return samples;
+}
+
+class Tuner {
+public:
+        Tuner (const std::vector<Sample> &samples_, size_t num_threads_)
+                : samples(samples_), num_threads(num_threads_), params(initial_params)
+        { }
+
+        // the scaling of the sigmoid that fits the current parameters best
+        auto fit_k () -> void
+        {
+                double lo = 0.1, hi = 10;
+                for (int i = 0; i < 50; i++) {
+                        const double m1 = lo + (hi - lo) / 3, m2 = hi - (hi - lo) / 3;
+                        k = m1;
+                        const double loss1 = loss_and_gradient(nullptr);
+                        k = m2;
+                        const double loss2 = loss_and_gradient(nullptr);
+                        (loss1 < loss2 ? hi : lo) = loss1 < loss2 ? m2 : m1;
+                }
+                k = (lo + hi) / 2;
+        }
+
+        // adam, the constants have very different scales
+        // a constant may change sign, the lazy eval bounds hold for either sign
+        auto run (int iterations) -> void
+        {
+                constexpr double learning_rate = 1, beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+                std::vector<double> gradient(num_params), m(num_params, 0), v(num_params, 0);
+
+                std::cout << "k " << k << ", initial loss " << loss_and_gradient(nullptr) << '\n';
+                for (int it = 1; it <= iterations; it++) {
+                        const double loss = loss_and_gradient(&gradient);
+                        for (size_t i = 0; i < num_params; i++) {
+                                m[i] = beta1 * m[i] + (1 - beta1) * gradient[i];
+                                v[i] = beta2 * v[i] + (1 - beta2) * gradient[i] * gradient[i];
+                                const double m_hat = m[i] / (1 - std::pow(beta1, it));
+                                const double v_hat = v[i] / (1 - std::pow(beta2, it));
+                                params[i] -= learning_rate * m_hat / (std::sqrt(v_hat) + epsilon);
+                        }
+                        if (it % 100 == 0 || it == iterations)
+                                std::cout << "iteration " << it << ", loss " << loss << '\n';
+                }
+        }
+
+        // in the same layout as eval-params.h
+        auto write_header (const std::string &path) const -> void
+        {
+                std::ofstream file(path);
+                file << "// the heuristic constants of the classical eval, in centi pawn\n"
+                     << "// the tuner (tools/tuner.cc) writes a file just like this one, which can replace it\n\n"
+                     << "#ifndef EVAL_PARAMS_H\n#define EVAL_PARAMS_H\n";
+
+                size_t idx = 0;
+                for (const Constant &c : constants) {
+                        if (c.group)
+                                file << '\n' << c.group << '\n';
+                        file << "constexpr int " << c.name;
+                        if (c.values.size() == 1) {
+                                file << " = " << std::lround(params[idx++]) << ";\n";
+                                continue;
+                        }
+                        file << '[' << c.values.size() << "] = {";
+                        for (size_t i = 0; i < c.values.size(); i++)
+                                file << (i ? ", " : "") << std::lround(params[idx++]);
+                        file << "};\n";
+                }
+                file << "\n#endif //EVAL_PARAMS_H\n";
+                std::cout << "wrote " << path << '\n';
+        }
+
+private:
+        // the win probability of an eval
+        auto sigmoid (double eval) const -> double {return 1 / (1 + std::pow(10.0, -k * eval / 400));}
+
+        // the mean squared error, and its gradient if asked for
+        // every thread does a slice of the samples
+        auto loss_and_gradient (std::vector<double> *gradient) const -> double
+        {
+                std::vector<double> losses(num_threads, 0);
+                std::vector<std::vector<double>> gradients(num_threads, std::vector<double>(num_params, 0));
+
+                auto work = [&](size_t t) {
+                        const size_t begin = samples.size() * t / num_threads;
+                        const size_t end = samples.size() * (t + 1) / num_threads;
+                        for (size_t s = begin; s < end; s++) {
+                                const Sample &sample = samples[s];
+                                const double prob = sigmoid(linear_eval(sample, params));
+                                const double error = sample.result - prob;
+                                losses[t] += error * error;
+                                if (!gradient)
+                                        continue;
+
+                                // d/dparam of (result - sigmoid(eval))^2
+                                const double d_eval = -2 * error * prob * (1 - prob) * std::log(10.0) * k / 400;
+                                for (size_t i = 0; i < num_params; i++) {
+                                        if (sample.coefficients[i] == 0)
+                                                continue;
+                                        const double weight = param_tapers[i] == Taper::mg ? sample.mg_fraction
+                                                            : param_tapers[i] == Taper::eg ? 1 - sample.mg_fraction : 1;
+                                        gradients[t][i] += d_eval * weight * sample.coefficients[i];
+                                }
+                        }
+                };
+
+                std::vector<std::thread> threads;
+                for (size_t t = 1; t < num_threads; t++)
+                        threads.emplace_back(work, t);
+                work(0);
+                for (std::thread &thread : threads)
+                        thread.join();
+
+                const double n = static_cast<double>(samples.size());
+                if (gradient) {
+                        std::ranges::fill(*gradient, 0);
+                        for (const std::vector<double> &g : gradients) {
+                                for (size_t i = 0; i < num_params; i++)
+                                        (*gradient)[i] += g[i] / n;
+                        }
+                }
+                double loss = 0;
+                for (const double l : losses)
+                        loss += l;
+                return loss / n;
+        }
+
+        const std::vector<Sample> &samples;
+        size_t num_threads;
+        std::vector<double> params;
+        double k = 1;
+};
+
+int main (int argc, char **argv)
+{
+        if (argc < 2) {
+                std::cerr << "usage: tuner <positions file> [output header = eval-params.h] [iterations = 1000] [threads]\n";
+                return EXIT_FAILURE;
+        }
+        const std::string output = argc > 2 ? argv[2] : "eval-params.h";
+        const int iterations = argc > 3 ? std::stoi(argv[3]) : 1000;
+        const size_t num_threads = argc > 4 ? std::stoul(argv[4]) : std::max(1u, std::thread::hardware_concurrency());
+
+        const std::vector<Sample> samples = load_samples(argv[1]);
+        if (samples.empty())
+                return EXIT_FAILURE;
+
+        Tuner tuner(samples, num_threads);
+        tuner.fit_k();
+        tuner.run(iterations);
+        tuner.write_header(output);
+        return 0;
+}
@@ -8,6 +8,9 @@
 #include "../src/cli/cli-game.h"
 #include <iostream>
 #include "../src/Engine/movegen.h"
+#include "unit-tests.h"
+#include <random>
+#include <atomic>
 auto test_engine () -> void;
 
 
@@ -76,48 +79,330 @@ auto test_nodegen() -> void
         }
 }
 
-auto test_threads () -> void
+// compares the repetition counts with a scan over all hashes, with few different hashes so there are many repetitions
+// the line gets longer than the buffer, but the counter never goes back that far
+auto test_repetition_history () -> void
 {
-        constexpr int max_depth = 8;
-        const Position &pos = start_position;
-        Engine engine(pos, TransTable::MegaByte(2048));
+        std::mt19937_64 gen(7);
+        std::vector<uint64_t> hashes(12);
+        for (uint64_t &h : hashes)
+                h = gen() & ~1ull;
 
-        std::cout << "filled for " << engine.filled_permille() << " \U00002030"<< std::endl;
+        std::vector<uint64_t> played;
+        for (int i = 0; i < 40; i++)
+                played.push_back(hashes[gen() % hashes.size()]);
 
-        engine.start_iterative_deepen(max_depth);
+        RepetitionHistory history;
+        history.reset(played);
+        std::vector<uint64_t> all = played;
 
-        constexpr int tickbuf = 6;
-        auto timebuff = [&](int sec) -> std::string {
-                std::string s = std::to_string(sec);
-                while (s.size() < tickbuf)
-                        s.push_back(' ');
-                return s;
+        auto check = [&](uint64_t hash, unsigned passive_move_counter) -> bool {
+                RepetitionHistory::Repetitions expected;
+                for (size_t back = 2; back <= passive_move_counter && back <= all.size(); back += 2) {
+                        const size_t idx = all.size() - back;
+                        if (all[idx] == hash)
+                                (idx >= played.size() ? expected.in_line : expected.on_board)++;
+                }
+                const RepetitionHistory::Repetitions reps = history.count(hash, passive_move_counter);
+                return reps.on_board == expected.on_board && reps.in_line == expected.in_line;
         };
 
-        int sec = 0;
-        while (true) {
-                int depth = 0;
-                auto p = engine.tt.find(engine.root.hash);
-                if (p)
-                        depth = p->depth_searched;
+        for (int step = 0; step < 20000; step++) {
+                const uint64_t hash = hashes[gen() % hashes.size()];
+                if (!check(hash, gen() % 120)) {
+                        failed_tests++;
+                        std::cout << "Error!\t repetition history counts wrong after " << all.size() << " positions" << std::endl;
+                        return;
+                }
+                // mostly longer, so it goes around the buffer a few times
+                if (all.size() > played.size() && gen() % 8 < 3) {
+                        history.pop();
+                        all.pop_back();
+                } else {
+                        history.push(hash);
+                        all.push_back(hash);
+                }
+        }
+}
+
+// the pv is a legal line that starts with the best move
+auto test_principal_variation () -> void
+{
+        const Position pos = *fromFen("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+        Engine engine(pos, TransTable::MegaByte(16));
+        engine.search(4);
 
-                std::cout << "second " << timebuff(sec) << "depth " << depth << std::endl;
-                if (depth >= max_depth)
+        const std::vector<Move> pv = engine.principal_variation();
+        bool legal = !pv.empty() && pv.front() == engine.demand_best_move();
+        Position line = pos;
+        for (const Move mv : pv) {
+                MoveList mlist;
+                if (line.meta.active == Color::white)
+                        generate_moves<Color::white>(line, mlist);
+                else
+                        generate_moves<Color::black>(line, mlist);
+                if (std::ranges::find(mlist, mv) == mlist.end()) {
+                        legal = false;
                         break;
+                }
+                PositionHashPair next(line, zobrist_hash(line));
+                if (line.meta.active == Color::white)
+                        make_move_unsafe<Color::white>(mv, next);
+                else
+                        make_move_unsafe<Color::black>(mv, next);
+                line = next.pos;
+        }
+        if (!legal) {
+                failed_tests++;
+                std::cout << "Error!\t the principal variation of " << pv.size() << " moves is not a legal line from the best move" << std::endl;
+        }
+}
+
+// the lines of multipv have different first moves, from best to worst, and the first one is the best move
+auto test_multi_pv () -> void
+{
+        static std::vector<SendInfoArgs> infos;
+        infos.clear();
+        const Position pos = *fromFen("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+        Engine engine(pos, [](const SendInfoArgs &args) {infos.push_back(args);}, nullptr, TransTable::MegaByte(16));
+        engine.options().multi_pv = 3;
+        engine.search(3);
+
+        std::vector<SendInfoArgs> last;
+        for (const SendInfoArgs &args : infos)
+                if (args.depth == 3u)
+                        last.push_back(args);
 
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-                sec++;
+        bool correct = last.size() == 3 && last[0].pv->front() == engine.demand_best_move();
+        for (size_t k = 0; correct && k < last.size(); k++) {
+                correct = last[k].multipv == k + 1 && last[k].pv && last[k].pv->size() > 1;
+                for (size_t j = 0; correct && j < k; j++)
+                        correct = last[j].pv->front() != last[k].pv->front()
+                                && last[j].score->engine_perspective >= last[k].score->engine_perspective;
+        }
+        if (!correct) {
+                failed_tests++;
+                std::cout << "Error!\t multipv sent " << last.size() << " lines that are not the 3 best different ones with a pv" << std::endl;
         }
-        std::cout << "filled for " << engine.filled_permille() << " \U00002030"<< std::endl;
-        /*
-        engine.stop_after(std::chrono::seconds(20));
-        std::this_thread::sleep_for(std::chrono::seconds(40));
-        */
 }
 
+// the limits fit in the clock, and the search stops sooner with a stable best move than with a changing one
+auto test_time_manager () -> void
+{
+        typedef TimeManager::Millis Millis;
+        const Millis time_left(60000);
+
+        const TimeManager limits(time_left, Millis(500), std::nullopt, 20);
+        if (!(limits.soft_limit() >= time_left / 40 && limits.soft_limit() < limits.hard_limit() && limits.hard_limit() < time_left)) {
+                failed_tests++;
+                std::cout << "Error!\t the time limits " << limits.soft_limit().count() << " and " << limits.hard_limit().count()
+                        << " ms do not fit in a clock of " << time_left.count() << " ms" << std::endl;
+        }
+
+        // every iteration takes 1.5 times as long as the one before, returns when it stops
+        auto stops_at = [&](bool unstable) -> Millis {
+                TimeManager tm(time_left, Millis(0), std::nullopt, 20);
+                const Move moves[2] = {Move(OneSquare(1, 4), OneSquare(3, 4)), Move(OneSquare(1, 3), OneSquare(3, 3))};
+                Millis elapsed(1), iteration(1);
+                for (int i = 0; !tm.should_stop(moves[unstable && i % 2], 30, elapsed); i++) {
+                        iteration *= 1.5;
+                        elapsed += iteration;
+                }
+                return elapsed;
+        };
+        const Millis stable = stops_at(false), unstable = stops_at(true);
+        if (stable > limits.hard_limit() || unstable > limits.hard_limit() || unstable <= stable) {
+                failed_tests++;
+                std::cout << "Error!\t the search stops at " << stable.count() << " ms with a stable best move and at "
+                        << unstable.count() << " ms with a changing one" << std::endl;
+        }
+
+        TimeManager single(time_left, Millis(0), std::nullopt, 1);
+        TimeManager mating(time_left, Millis(0), std::nullopt, 20);
+        if (!single.should_stop(Move{}, 0, Millis(1)) || !mating.should_stop(Move{}, worst_black - 3, Millis(1))) {
+                failed_tests++;
+                std::cout << "Error!\t the search does not stop right away with one legal move or a mate" << std::endl;
+        }
+}
+
+// on a clock, a position with a single legal move is played right away
+auto test_go_on_clock () -> void
+{
+        static std::atomic<bool> got_best_move;
+        got_best_move = false;
+        const Position pos = *fromFen("7k/8/8/8/8/7P/5PP1/r5K1 w - - 0 1");
+        Engine engine(pos, nullptr, [](Move, Color) {got_best_move = true;}, TransTable::MegaByte(16));
+
+        Engine::GoArgs args;
+        args.wtime = 600000;
+        args.btime = 600000;
+        const auto start = std::chrono::steady_clock::now();
+        engine.go(args);
+        while (!got_best_move && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        if (!got_best_move || waited > std::chrono::seconds(1)) {
+                failed_tests++;
+                std::cout << "Error!\t the only legal move took " << waited.count() << " ms on a clock of 10 minutes" << std::endl;
+        }
+}
+
+// go nodes stops at the same place every time, and go mate stops at the mate
+auto test_go_limits () -> void
+{
+        static std::vector<SendInfoArgs> infos;
+        static std::atomic<bool> got_best_move;
+        static Move best_move;
+        auto go = [](const Position &pos, const Engine::GoArgs &args) -> std::vector<SendInfoArgs> {
+                infos.clear();
+                got_best_move = false;
+                Engine engine(pos, [](const SendInfoArgs &info) {infos.push_back(info);},
+                        [](Move mv, Color) {best_move = mv; got_best_move = true;}, TransTable::MegaByte(16));
+                const auto start = std::chrono::steady_clock::now();
+                engine.go(args);
+                while (!got_best_move && std::chrono::steady_clock::now() - start < std::chrono::seconds(10))
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                return infos;
+        };
+
+        constexpr size_t node_limit = 20000;
+        Engine::GoArgs node_args;
+        node_args.nodes = node_limit;
+        const std::vector<SendInfoArgs> first = go(start_position, node_args);
+        const Move first_move = best_move;
+        const std::vector<SendInfoArgs> second = go(start_position, node_args);
+        bool same = got_best_move && first.size() == second.size() && best_move == first_move;
+        for (size_t i = 0; same && i < first.size(); i++)
+                same = first[i].nodes == second[i].nodes && first[i].nodes <= node_limit && first[i].pv == second[i].pv;
+        if (!same) {
+                failed_tests++;
+                std::cout << "Error!\t two searches of " << node_limit << " nodes do not send the same info and best move" << std::endl;
+        }
+
+        const Position mate_in_one = *fromFen("6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1");
+        Engine::GoArgs mate_args;
+        mate_args.mate_in = 3;
+        const std::vector<SendInfoArgs> mate = go(mate_in_one, mate_args);
+        const bool found = got_best_move && best_move == Move(OneSquare(0, 3), OneSquare(7, 3)) && !mate.empty()
+                && mate.back().score && mate.back().score->mate == 1 && mate.back().depth == 2u;
+        if (!found) {
+                failed_tests++;
+                std::cout << "Error!\t go mate 3 does not stop at the mate in 1 after 2 plies" << std::endl;
+        }
+}
+
+// the root entry of a search with searchmoves is not used by the next search without
+auto test_searchmoves_then_go () -> void
+{
+        static std::atomic<bool> got_best_move;
+        static Move best_move;
+        Engine engine(start_position, nullptr, [](Move mv, Color) {best_move = mv; got_best_move = true;}, TransTable::MegaByte(16));
+        auto go = [&](const Engine::GoArgs &args) -> std::optional<Move> {
+                got_best_move = false;
+                const auto start = std::chrono::steady_clock::now();
+                engine.go(args);
+                while (!got_best_move && std::chrono::steady_clock::now() - start < std::chrono::seconds(10))
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                if (!got_best_move)
+                        return std::nullopt;
+                return best_move;
+        };
+
+        Engine fresh(start_position, TransTable::MegaByte(16));
+        fresh.search(4);
+        const Move expected = *fresh.demand_best_move();
+
+        Engine::GoArgs restricted;
+        restricted.depth = 4;
+        restricted.move_list = MoveList{};
+        restricted.move_list->emplace_back(*fromAlgebraic("a2a3", start_position));
+        restricted.move_list->emplace_back(*fromAlgebraic("h2h3", start_position));
+        const std::optional<Move> first = go(restricted);
+
+        Engine::GoArgs free;
+        free.depth = 4;
+        const std::optional<Move> second = go(free);
+        if (!first || !second) {
+                failed_tests++;
+                std::cout << "Error!\t no bestmove within 10 seconds of go depth 4, with searchmoves " << first.has_value()
+                        << ", without " << second.has_value() << std::endl;
+                return;
+        }
+        if (*second != expected || std::ranges::find(*restricted.move_list, *first) == restricted.move_list->end()) {
+                failed_tests++;
+                std::cout << "Error!\t after searchmoves a2a3 h2h3 the engine plays " << toAlgebraic(*second, Color::white)
+                        << " instead of " << toAlgebraic(expected, Color::white) << std::endl;
+        }
+}
+
+// the search stops at the deadline of go movetime and by stop, and either way bestmove is sent exactly once
+// the time it takes is reported by bench
+auto test_stop_sends_once () -> void
+{
+        typedef std::chrono::steady_clock Clock;
+        static std::atomic<int> best_moves;
+        static std::atomic<Clock::time_point> sent;
+        const Position pos = *fromFen("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+        Engine engine(pos, nullptr, [](Move, Color) {sent = Clock::now(); best_moves++;}, TransTable::MegaByte(16));
+
+        auto wait_for_stop = [&](Clock::time_point start) -> void {
+                while ((engine.running() || best_moves == 0) && Clock::now() - start < std::chrono::seconds(10))
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                // a second bestmove would come right after the first
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        };
+
+        best_moves = 0;
+        Engine::GoArgs timed;
+        timed.move_time = 30;
+        const Clock::time_point start = Clock::now();
+        engine.go(timed);
+        wait_for_stop(start);
+        const bool stopped_in_time = !engine.running() && best_moves == 1;
+        const bool not_early = sent.load() - start >= std::chrono::milliseconds(*timed.move_time);
+
+        best_moves = 0;
+        Engine::GoArgs infinite;
+        infinite.infinite = true;
+        engine.go(infinite);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        const bool still_running = engine.running() && best_moves == 0;
+        engine.stop();
+        engine.stop();
+        const bool stopped = !engine.running() && best_moves == 1;
+
+        // stop at the deadline, while the worker sends bestmove by itself
+        int races_sent_once = 0;
+        constexpr int races = 20;
+        for (int i = 0; i < races; i++) {
+                best_moves = 0;
+                Engine::GoArgs quick;
+                quick.move_time = 1;
+                engine.go(quick);
+                std::this_thread::sleep_for(std::chrono::microseconds(500 + 50 * i));
+                engine.stop();
+                wait_for_stop(Clock::now());
+                races_sent_once += best_moves == 1;
+        }
+
+        if (!stopped_in_time || !not_early || !still_running || !stopped || races_sent_once != races) {
+                failed_tests++;
+                std::cout << "Error!\t bestmove is not sent exactly once when the search stops: after movetime "
+                        << stopped_in_time << not_early << ", infinite " << still_running << stopped
+                        << ", " << races_sent_once << " of " << races << " races" << std::endl;
+        }
+}
 
 auto test_engine () -> void
 {
+        test_repetition_history();
+        test_principal_variation();
+        test_multi_pv();
+        test_time_manager();
+        test_go_on_clock();
+        test_go_limits();
+        test_searchmoves_then_go();
+        test_stop_sends_once();
         // test_nodegen();
-        test_threads();
 }
\ No newline at end of file
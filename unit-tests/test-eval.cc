@@ -2,15 +2,24 @@
 // Created by Hugo Bogaart on 23/07/2024.
 //
 
+#include "unit-tests.h"
+#include "test-positions.h"
 #include "../src/cli/cli-utils.h"
 #include "../src/cli/cli-game.h"
 
 #include "../src/Engine/position.h"
 #include "../src/Engine/eval.h"
+#include "../src/Engine/nnue.h"
+#include "../src/Engine/movegen.h"
 
 auto test_eval () -> void;
 
 #include <iostream>
+#include <vector>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <span>
 
 auto test_eval_deep () -> void
 {
@@ -49,7 +58,333 @@ auto test_eval_deep () -> void
         */
 }
 
+// the way static_eval used to be calculated, everything from scratch at once
+// the terms of one piece on one square are tapered, so those are kept apart for midgame and endgame
+struct ScratchEval {
+        Eval mg_piece_square = 0;
+        Eval eg_piece_square = 0;
+        Eval rest = 0;
+};
+
+template <Color col>
+auto eval_col_from_scratch (const Position &board) -> ScratchEval
+{
+        constexpr bool is_white = col == Color::white;
+
+        Eval score = 0;
+        Eval mg = 0;
+        Eval eg = 0;
+        const Field atm = board.attack_map<col>();
+        const Field all_friendly = board.get_occupation<col>();
+
+        const Field &queens  = board.queen<col>(),
+                    &pawns   = board.pawns<col>(),
+                    &rooks   = board.rooks<col>(),
+                    &horses  = board.horses<col>(),
+                    &bishops = board.bishops<col>(),
+                    &king    = board.king<col>();
+
+        const Field &enemy_queens  = board.queen<!col>(),
+                    &enemy_pawns   = board.pawns<!col>(),
+                    &enemy_rooks   = board.rooks<!col>(),
+                    &enemy_horses  = board.horses<!col>(),
+                    &enemy_bishops = board.bishops<!col>(),
+                    &enemy_king    = board.king<!col>();
+
+
+        const uint8_t num_queens  = bit_count(queens),
+                      num_pawns   = bit_count(pawns),
+                      num_rooks   = bit_count(rooks),
+                      num_horses  = bit_count(horses),
+                      num_bishops = bit_count(bishops);
+
+        mg  = queen_val  * num_queens;
+        mg += rook_val   * num_rooks;
+        mg += horse_val  * num_horses;
+        mg += bishop_val * num_bishops;
+        mg += pawn_val   * num_pawns;
+        eg  = queen_val  * num_queens;
+        eg += rook_val   * num_rooks;
+        eg += horse_val  * num_horses;
+        eg += bishop_val * num_bishops;
+        eg += pawn_val_eg * num_pawns;
+
+        // bonus bishop pair if there are bishops on both colors
+        if (bishops & msk::white_squares && bishops & msk::black_squares) {
+                score += bishop_pair_bonus;
+        }
+
+        // assign score to "activity" of board
+        score += par_square_attack_score * bit_count(atm);      // general activity
+
+        // attacking pieces is good too
+        score += queen_attack_val  * bit_count(atm & enemy_queens);
+        score += rook_attack_val   * bit_count(atm & enemy_rooks);
+        score += bishop_attack_val * bit_count(atm & enemy_bishops);
+        score += horse_attack_val  * bit_count(atm & enemy_horses);
+        score += pawn_attack_val   * bit_count(atm & enemy_pawns);
+
+        auto rel_rank = [](int r) -> Field {
+                return is_white ? msk::rank[r] : msk::rank[7 - r];
+        };
+
+        // central pawns are worth more
+        mg += pawn_center_val * bit_count(pawns & ~msk::file[0] & ~msk::file[7]);
+
+        // and rook-file pawns less
+        mg -= rook_file_pawn_penalty * bit_count(pawns & (msk::file[0] | msk::file[7]));
+
+        // pawn promotion
+        // score += 1. * bit_count(board.pawns<col>() & rel_rank(5));
+        // score += 2. * bit_count(board.pawns<col>() & rel_rank(6));
+
+        mg += pawn_advanced_mg[0] * bit_count(pawns & rel_rank(5));
+        mg += pawn_advanced_mg[1] * bit_count(pawns & rel_rank(6));
+        eg += pawn_advanced_eg[0] * bit_count(pawns & rel_rank(5));
+        eg += pawn_advanced_eg[1] * bit_count(pawns & rel_rank(6));
+
+        // horsies get penalty on the edges, and the king wants to be central in the endgame
+        for (int r = 0; r < 4; r++) {
+                mg += horse_ring_mg[r] * bit_count(horses & msk::ring[r]);
+                eg += horse_ring_eg[r] * bit_count(horses & msk::ring[r]);
+                eg += king_ring_eg[r] * bit_count(king & msk::ring[r]);
+        }
+
+        // horses get a bonus if there are more pawns
+        score += num_horses * horse_pawn_bonus * bit_count(pawns | enemy_pawns);
+
+        // bishops get a slight penalty for pawns
+        score -= num_bishops * bishop_pawn_penalty * bit_count(pawns | enemy_pawns);
+
+        // bonus for rooks that don't look at a friendly pawn ahead
+
+        int num_unblocked_rooks = 0;
+        int num_double_pawns = 0;
+        for (Field file = msk::file[0]; file; shift<east>(file)) {
+                if (file & rooks && (file & pawns) == 0ull) {
+                        num_unblocked_rooks++;
+                }
+                const int num_pawns = bit_count(pawns & file);
+                if (num_pawns > 1) {
+                        num_double_pawns += num_pawns - 1;
+                }
+        }
+
+        score += unblocked_rook_score * num_unblocked_rooks;
+        score -= double_pawn_penalty * num_double_pawns;
+
+        // pawns seeing bigger pieces is a nice bonus
+        const Field pawns_east_attack = is_white ? shifted<northEast>(pawns) : shifted<southEast>(pawns);
+        const Field pawns_west_attack = is_white ? shifted<northWest>(pawns) : shifted<southWest>(pawns);;
+
+        score += pawn_chain_defense_bonus * bit_count(pawns_east_attack & pawns);
+        score += pawn_chain_defense_bonus * bit_count(pawns_west_attack & pawns);
+
+        score += pawn_delta_attack_val * ((rook_val - 100) / 100) * bit_count(pawns_east_attack & enemy_rooks);
+        score += pawn_delta_attack_val * ((rook_val - 100) / 100) * bit_count(pawns_west_attack & enemy_rooks);
+        score += pawn_delta_attack_val * ((queen_val - 100) / 100) * bit_count(pawns_east_attack & enemy_queens);
+        score += pawn_delta_attack_val * ((queen_val - 100) / 100) * bit_count(pawns_west_attack & enemy_queens);
+        score += pawn_delta_attack_val * ((horse_val - 100) / 100) * bit_count(pawns_east_attack & enemy_horses);
+        score += pawn_delta_attack_val * ((horse_val - 100) / 100) * bit_count(pawns_west_attack & enemy_horses);
+        score += pawn_delta_attack_val * ((bishop_val - 100) / 100) * bit_count(pawns_east_attack & enemy_bishops);
+        score += pawn_delta_attack_val * ((bishop_val - 100) / 100) * bit_count(pawns_west_attack & enemy_bishops);
+
+        // and king safety
+        mg += king_safety_2ndlastrank_val * bit_count(king & (msk::rank[1] | msk::rank[6]));
+        mg += king_safety_2ndlastrank_val * bit_count(king & (msk::file[1] | msk::file[6]));
+        mg += king_safety_lastrank_val * bit_count(king & (msk::rank[0] | msk::rank[7]));
+        mg += king_safety_lastrank_val * bit_count(king & (msk::file[0] | msk::file[7]));
+
+        // penalty for open area around king
+        score -= king_open_area_penalty * bit_count(get_king_area(OneSquare_unsafe(king)) & ~all_friendly);
+
+        if (atm & enemy_king)
+                score += attack_other_king_val;
+
+        return {mg, eg, score};
+}
+
+// static_eval keeps the material and piece square terms in the board
+// they should add up to exactly what the full eval gives, also for positions reached by making moves
+auto test_incremental_eval () -> void
+{
+        const std::vector<Position> positions = collect_perft_positions(3);
+        for (const Position &pos : positions) {
+                const ScratchEval white = eval_col_from_scratch<Color::white>(pos);
+                const ScratchEval black = eval_col_from_scratch<Color::black>(pos);
+                const int phase = 4 * bit_count(pos.queen<Color::white>() | pos.queen<Color::black>())
+                                + 2 * bit_count(pos.rooks<Color::white>() | pos.rooks<Color::black>())
+                                + bit_count(pos.horses<Color::white>() | pos.horses<Color::black>()
+                                            | pos.bishops<Color::white>() | pos.bishops<Color::black>());
+                const int mg_phase = std::min(phase, max_phase);
+                const Eval piece_square = ((white.mg_piece_square - black.mg_piece_square) * mg_phase
+                                           + (white.eg_piece_square - black.eg_piece_square) * (max_phase - mg_phase)) / max_phase;
+                const Eval from_scratch = truncated(piece_square + white.rest - black.rest);
+                if (!pos.piece_square_is_consistent() || static_eval(pos) != from_scratch) {
+                        failed_tests++;
+                        std::cout << "Error!\t static_eval differs from the eval from scratch" << std::endl;
+                        print(pos);
+                        return;
+                }
+        }
+}
+
+// the lazy eval may only exit early with a bound that the real eval respects
+auto test_lazy_eval () -> void
+{
+        // the bounds of a sum of terms hold for coefs of either sign, whatever the params are now
+        std::mt19937 gen(3);
+        std::uniform_int_distribution<int> coef_dist(-50, 50), count_dist(0, 64);
+        for (int i = 0; i < 1000; i++) {
+                const int coef1 = coef_dist(gen), max1 = count_dist(gen);
+                const int coef2 = coef_dist(gen), max2 = count_dist(gen);
+                EvalBounds bounds;
+                bounds.add(coef1, max1);
+                bounds.add(coef2, max2);
+                for (const int count1 : {0, max1 / 2, max1}) {
+                        for (const int count2 : {0, max2 / 2, max2}) {
+                                const Eval sum = coef1 * count1 + coef2 * count2;
+                                if (sum > bounds.above || sum < -bounds.below) {
+                                        failed_tests++;
+                                        std::cout << "Error!	 " << coef1 << " * " << count1 << " + " << coef2 << " * " << count2
+                                                  << " is outside the eval bounds " << -bounds.below << ", " << bounds.above << std::endl;
+                                        return;
+                                }
+                        }
+                }
+        }
+
+        const std::vector<Position> positions = collect_perft_positions(3);
+        PawnTable pawn_table;
+        for (const Position &pos : positions) {
+                const PositionHashPair pos_hash(pos, zobrist_hash(pos));
+                const Eval eval = static_eval(pos);
+                for (const Eval window_mid : {-1000, -300, 0, 300, 1000}) {
+                        const Eval alpha = window_mid - 50;
+                        const Eval beta = window_mid + 50;
+                        const LazyEval lazy = lazy_static_eval(pos_hash, pawn_table, alpha, beta);
+                        const bool correct = lazy.exact ? lazy.eval == eval
+                                : (lazy.eval > beta && eval >= lazy.eval) || (lazy.eval < alpha && eval <= lazy.eval);
+                        if (!correct) {
+                                failed_tests++;
+                                std::cout << "Error!\t lazy eval " << lazy.eval << " does not hold for eval " << eval
+                                          << " in window [" << alpha << ", " << beta << "]" << std::endl;
+                                print(pos);
+                                return;
+                        }
+                }
+        }
+}
+
+// the batch must give exactly the evals of static_eval, also for a last block that is not full
+auto test_eval_batch () -> void
+{
+        const std::vector<Position> positions = collect_perft_positions(3);
+        for (const size_t count : {positions.size(), positions.size() - 3, size_t(5), size_t(1)}) {
+                const std::span<const Position> batch(positions.data(), count);
+                std::vector<Eval> evals(count);
+                static_eval_batch(batch, evals);
+                for (size_t i = 0; i < count; i++) {
+                        if (evals[i] != static_eval(batch[i])) {
+                                failed_tests++;
+                                std::cout << "Error!\t static_eval_batch gives " << evals[i]
+                                          << " but static_eval " << static_eval(batch[i]) << std::endl;
+                                print(batch[i]);
+                                return;
+                        }
+                }
+        }
+}
+
+template <Color col>
+auto nnue_update_is_correct (const Nnue::Network &net, const Position &pos) -> bool
+{
+        Nnue::Accumulator parent;
+        Nnue::refresh(net, pos, parent);
+
+        MoveList move_list;
+        generate_moves<col>(pos, move_list);
+        for (const Move mv : move_list) {
+                PositionHashPair next(pos, zobrist_hash(pos));
+                make_move_unsafe<col>(mv, next);
+
+                Nnue::Accumulator updated, refreshed;
+                Nnue::update(net, pos, next.pos, parent, updated);
+                Nnue::refresh(net, next.pos, refreshed);
+                if (!std::ranges::equal(updated.values[0], refreshed.values[0])
+                    || !std::ranges::equal(updated.values[1], refreshed.values[1])
+                    || Nnue::evaluate(net, updated, !col) != Nnue::evaluate(net, next.pos)) {
+                        std::cout << "Error!\t the updated accumulator differs from the refreshed one after "
+                                  << toAlgebraic(mv, col) << std::endl;
+                        print(pos);
+                        return false;
+                }
+        }
+        return true;
+}
+
+// the accumulator after any move must be the same as when calculated from scratch
+// and a network must survive being written and loaded
+auto test_nnue () -> void
+{
+        const std::unique_ptr<Nnue::Network> net = random_network();
+
+        for (const Position &pos : collect_perft_positions(2)) {
+                const bool correct = pos.meta.active == Color::white ? nnue_update_is_correct<Color::white>(*net, pos)
+                                                                     : nnue_update_is_correct<Color::black>(*net, pos);
+                if (!correct) {
+                        failed_tests++;
+                        return;
+                }
+        }
+
+        // the file is the network without padding
+        const std::filesystem::path path = std::filesystem::temp_directory_path() / "test-nnue.bin";
+        {
+                std::ofstream file(path, std::ios::binary);
+                auto write = [&](const int16_t *src, size_t count) {
+                        file.write(reinterpret_cast<const char *>(src), static_cast<std::streamsize>(count * sizeof(int16_t)));
+                };
+                write(&net->feature_weights[0][0], Nnue::num_features * Nnue::hidden_size);
+                write(net->feature_bias, Nnue::hidden_size);
+                write(&net->output_weights[0][0], 2 * Nnue::hidden_size);
+                write(&net->output_bias, 1);
+        }
+        const std::unique_ptr<Nnue::Network> loaded = Nnue::load_network(path.string());
+        std::filesystem::remove(path);
+        if (!loaded || Nnue::evaluate(*loaded, start_position) != Nnue::evaluate(*net, start_position)) {
+                failed_tests++;
+                std::cout << "Error!\t the loaded network differs from the written one" << std::endl;
+        }
+}
+
+// the ways to find the squares the sliders attack agree on the perft positions
+// their speed is in the microbench
+auto test_slider_attacks () -> void
+{
+        const std::vector<Position> positions = collect_perft_positions(3);
+
+        for (const Position &pos : positions) {
+                const Field white_atm = pos.attack_map<Color::white, SliderAttacks::lookup_table>();
+                const Field black_atm = pos.attack_map<Color::black, SliderAttacks::lookup_table>();
+                if (white_atm != pos.attack_map<Color::white, SliderAttacks::kogge_stone>()
+                    || black_atm != pos.attack_map<Color::black, SliderAttacks::kogge_stone>()
+                    || white_atm != pos.attack_map<Color::white, SliderAttacks::kogge_stone_avx2>()
+                    || black_atm != pos.attack_map<Color::black, SliderAttacks::kogge_stone_avx2>()) {
+                        failed_tests++;
+                        std::cout << "Error!\t the slider attacks differ" << std::endl;
+                        print(pos);
+                        return;
+                }
+        }
+}
+
 auto test_eval () -> void
 {
         test_eval_deep();
+        test_incremental_eval();
+        test_lazy_eval();
+        test_eval_batch();
+        test_nnue();
+        test_slider_attacks();
 }
\ No newline at end of file
@@ -2,13 +2,17 @@
 // Created by Hugo Bogaart on 25/07/2024.
 //
 
+#include "unit-tests.h"
+#include "test-positions.h"
 #include "../src/Engine/movegen.h"
 #include "../src/Engine/position.h"
 #include <algorithm>
 #include <iostream>
 #include <cassert>
+#include <vector>
 #include "../src/Engine/zobrist-hash.h"
 #include "../src/cli/cli-utils.h"
+#include "../src/Engine/perft.h"
 
 auto test_movegen () -> void;
 
@@ -22,45 +26,6 @@ auto test_generate_moves () -> void
 
 #include "../src/cli/cli-game.h"
 
-template <Color col>
-auto perft_col (const Position &position, int ply) -> size_t
-{
-        if (ply == 0)
-                return 1;
-
-        MoveList mlist;
-        //generate_moves2<col>(position, mlist);
-        // generate_moves_sorted<col>(position, mlist);
-        generate_moves<col>(position, mlist);
-
-        size_t count = 0;
-        for (Move mv : mlist) {
-                Position copy = position;
-                make_move_unsafe<col>(mv, copy);
-
-                /*
-                auto k = maybe_make_move<col>(mv, position);
-                if (!k) {
-                        print(position);
-                        print(copy);
-                        std::cout << (int)mv.from_file() << '\t' << (int)mv.from_rank() << "\n"
-                        << (int)mv.to_file() << '\t' << (int)mv.to_rank() << "\n" << mv.special << std::endl;
-                }
-                */
-
-                count += perft_col<!col>(copy, ply - 1);
-        }
-        return count;
-}
-
-
-auto perft (const Position &position, int ply) -> size_t
-{
-        if (position.meta.active == Color::white)
-                return perft_col<Color::white>(position, ply);
-        return perft_col<Color::black>(position, ply);
-}
-
 /*
 template <Color col>
 auto perft_compare_col (const Position &position, int ply) -> size_t
@@ -145,6 +110,7 @@ auto test_perft () -> void
                         std::cout << "\tdepth " << ply << '\t' << res << '\n';
                         // std::cout << "\tthis took " << time << " s" << std::endl;
                         if (res != results[ply - 1]) {
+                                failed_tests++;
                                 std::cout << "Error!\t the real number should be " << results[ply - 1] << std::endl;
                         }
                 }
@@ -245,6 +211,15 @@ auto test_perft () -> void
         };
         std::cout << "\nposition 6\n";
         test_pos(pos6, 5, pos6_results);
+
+        // the threads and the shared table should not change the count
+        PerftTable table(16);
+        const size_t parallel_res = parallel_perft(pos2, 4, 4, &table);
+        std::cout << "\nparallel perft position 2\n\tdepth 4\t" << parallel_res << '\n';
+        if (parallel_res != pos2_results[3]) {
+                failed_tests++;
+                std::cout << "Error!\t the real number should be " << pos2_results[3] << std::endl;
+        }
 }
 
 size_t hash_misses = 0;
@@ -291,9 +266,7 @@ auto test_perft2 () -> void
 {
         // tests the movegen on a position up to a maximum ply, given some results
         auto test_pos = []<size_t n>(const Position &pos, int max_ply, const std::array<size_t, n> &results) {
-                PositionHashPair pos_hash{};
-                pos_hash.pos = pos;
-                pos_hash.hash = zobrist_hash(pos);
+                const PositionHashPair pos_hash(pos, zobrist_hash(pos));
                 for (int ply = 1; ply <= max_ply; ply++) {
                         size_t res;
                         double time;
@@ -304,6 +277,7 @@ auto test_perft2 () -> void
                         std::cout << "\tdepth " << ply << '\t' << res << '\n';
                         // std::cout << "\tthis took " << time << " s" << std::endl;
                         if (res != results[ply - 1]) {
+                                failed_tests++;
                                 std::cout << "Error!\t the real number should be " << results[ply - 1] << std::endl;
                         }
                 }
@@ -419,14 +393,114 @@ auto benchmark_movegen ()
         std::cout << "perft took " << time << " seconds\nto evaluate " << num << " positions." << std::endl;
 }
 
+// the way attack_map used to be calculated, one square at a time
+template <Color col>
+auto attack_map_by_squares (const Position &pos) -> Field
+{
+        const Field friendly_occ = pos.get_occupation<col>();
+        const Field all = pos.get_total_occupation();
+        Field attack = 0;
+        if constexpr (col == Color::white) {
+                attack |= shifted<northEast>(pos.pawns<col>());
+                attack |= shifted<northWest>(pos.pawns<col>());
+        } else /* black */ {
+                attack |= shifted<southEast>(pos.pawns<col>());
+                attack |= shifted<southWest>(pos.pawns<col>());
+        }
+        const Field straight_attackers = pos.rooks<col>()   | pos.queen<col>();
+        const Field diagonal_attackers = pos.bishops<col>() | pos.queen<col>();
+        for (const auto sq : all_squares) {
+                if (!(sq & friendly_occ))
+                        continue;
+                if (sq & straight_attackers)
+                        attack |= get_weakly_blocked_straights(sq, all);
+                if (sq & diagonal_attackers) {
+                        attack |= get_weakly_blocked_diagonals(sq, all);
+                } else if (sq & pos.horses<col>()) {
+                        attack |= get_horse_jumps(sq);
+                } else if (sq & pos.king<col>()) {
+                        attack |= get_king_area(sq);
+                }
+        }
+        return attack & ~friendly_occ;
+}
+
+// attack_map agrees with the square by square version on the perft positions
+// its speed is in the microbench
+auto test_attack_map () -> void
+{
+        const std::vector<Position> positions = collect_perft_positions(3);
+
+        for (const Position &pos : positions) {
+                if (pos.attack_map<Color::white>() != attack_map_by_squares<Color::white>(pos)
+                    || pos.attack_map<Color::black>() != attack_map_by_squares<Color::black>(pos)) {
+                        failed_tests++;
+                        std::cout << "Error!\t attack_map differs from the square by square version" << std::endl;
+                        print(pos);
+                        return;
+                }
+        }
+}
+
+// the way zobrist_hash used to be calculated, every square of every piece
+auto zobrist_hash_by_squares (const Position &pos) -> uint64_t
+{
+        using namespace HashConstants;
+
+        uint64_t hash = 0;
+        for (int piece = 0; piece < 12; piece++) {
+                const auto pc = static_cast<Epiece>(piece);
+                for (int sq = 0; sq < 64; sq++) {
+                        if (pos.piece_field(pc) & square_from_shift(sq))
+                                hash ^= piece_square_hash(pc, sq);
+                }
+        }
+        if (pos.meta.active == Color::black)
+                hash ^= black_move_hash;
+        hash ^= castling_right_hash(pos.meta.castle_rights);
+        hash ^= en_passant_hash(pos.meta.pawn2fwd_file());
+        return hash;
+}
+
+template <Color col>
+auto incremental_hashes_are_correct (const Position &pos) -> bool
+{
+        MoveList mlist;
+        generate_moves<col>(pos, mlist);
+        for (Move mv : mlist) {
+                PositionHashPair next(pos, zobrist_hash(pos));
+                make_move_incremental<col>(mv, next);
+                if (next.hash != zobrist_hash(next.pos) || next.pawn_hash != pawn_zobrist_hash(next.pos))
+                        return false;
+        }
+        return true;
+}
 
+// the full hash against the square by square version,
+// and the incremental hashes of all moves against the full one, also without asserts
+auto test_zobrist_hash () -> void
+{
+        for (const Position &pos : collect_perft_positions(3)) {
+                const bool incremental_correct = pos.meta.active == Color::white
+                        ? incremental_hashes_are_correct<Color::white>(pos)
+                        : incremental_hashes_are_correct<Color::black>(pos);
+                if (zobrist_hash(pos) != zobrist_hash_by_squares(pos) || !incremental_correct) {
+                        failed_tests++;
+                        std::cout << "Error!\t zobrist hash is wrong" << std::endl;
+                        print(pos);
+                        return;
+                }
+        }
+}
 
 auto test_movegen() -> void
 {
         // test_generate_moves();
         // benchmark_movegen();
+        test_attack_map();
 
         test_perft();
+        test_zobrist_hash();
         // test_perft2(); // also tests hash propagation
 
         const std::optional<Position> pos6_ = fromFen("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
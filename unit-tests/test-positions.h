@@ -0,0 +1,79 @@
+//
+// Created by Hugo Bogaart on 19/10/2026.
+//
+
+#ifndef TEST_POSITIONS_H
+#define TEST_POSITIONS_H
+
+// the positions and the network that the tests and the microbench both run on
+
+#include "../src/Engine/movegen.h"
+#include "../src/Engine/position.h"
+#include "../src/Engine/nnue.h"
+#include "../src/Engine/zobrist-hash.h"
+#include "../src/cli/cli-utils.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <random>
+#include <vector>
+
+// the positions of the perft test
+constexpr std::array<const char *, 6> perft_fens = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"
+};
+
+// adds all positions up to some ply from pos to the vector, each before the positions after it
+template <Color col>
+auto collect_positions (const Position &pos, int ply, std::vector<Position> &positions) -> void
+{
+        positions.push_back(pos);
+        if (ply == 0)
+                return;
+
+        MoveList mlist;
+        generate_moves<col>(pos, mlist);
+        for (Move mv : mlist) {
+                PositionHashPair next{pos, zobrist_hash(pos)};
+                make_move_unsafe<col>(mv, next);
+                collect_positions<!col>(next.pos, ply - 1, positions);
+        }
+}
+
+// all positions up to some ply from the perft positions
+inline
+auto collect_perft_positions (int ply) -> std::vector<Position>
+{
+        std::vector<Position> positions;
+        for (const char *fen : perft_fens) {
+                const Position pos = *fromFen(fen);
+                if (pos.meta.active == Color::white)
+                        collect_positions<Color::white>(pos, ply, positions);
+                else
+                        collect_positions<Color::black>(pos, ply, positions);
+        }
+        return positions;
+}
+
+// a network with small random weights and biases, so that the accumulator does not overflow
+inline
+auto random_network () -> std::unique_ptr<Nnue::Network>
+{
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<int> dist(-64, 64);
+        auto net = std::make_unique<Nnue::Network>();
+        for (auto &column : net->feature_weights)
+                std::ranges::generate(column, [&] {return static_cast<int16_t>(dist(gen));});
+        std::ranges::generate(net->feature_bias, [&] {return static_cast<int16_t>(dist(gen));});
+        for (auto &weights : net->output_weights)
+                std::ranges::generate(weights, [&] {return static_cast<int16_t>(dist(gen));});
+        net->output_bias = static_cast<int16_t>(dist(gen));
+        return net;
+}
+
+#endif //TEST_POSITIONS_H
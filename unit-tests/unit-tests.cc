@@ -3,6 +3,7 @@
 //
 
 #include "unit-tests.h"
+#include <cstdlib>
 
 // the main tests from all unit test files
 extern auto test_bitfield       () -> void;
@@ -18,11 +19,17 @@ auto run_tests () -> void
 {
 
         // test_bitfield();
-        // test_eval();
+        test_eval();
         // test_position();
         // test_cli_utils();
         // test_uci();
         test_movegen();
         // test_transtable();
-        // test_engine();
+        test_engine();
+}
+
+int main ()
+{
+        run_tests();
+        return failed_tests == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
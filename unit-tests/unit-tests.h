@@ -11,5 +11,8 @@
 
 auto run_tests () -> void;
 
+// the tests that print an error also count it here, so the test executable can fail
+inline int failed_tests = 0;
+
 
 #endif //UNIT_TESTS_H